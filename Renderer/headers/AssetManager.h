@@ -0,0 +1,67 @@
+#pragma once
+#include "ModelData.h"
+#include "ThreadPool.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+
+// Loads model data (cache read or full import) on the thread pool while the renderer keeps
+// drawing. requestModel returns a handle immediately; once the CPU side is done the context
+// thread picks the result up with takeLoaded, creates its GL objects and marks it resident.
+// Nothing here touches GL.
+class AssetManager {
+public:
+    typedef unsigned int Handle;
+    static const Handle kInvalidHandle = 0;
+
+    enum State {
+        State_Unknown,  // Never requested, or released
+        State_Loading,  // Being read or imported on a worker
+        State_Loaded,   // CPU data ready, waiting for takeLoaded
+        State_Resident, // GL objects created by the renderer
+        State_Failed
+    };
+
+    // Fills modelData from path; runs on a worker thread
+    typedef std::function<bool(const std::string& path, ModelData& modelData)> Loader;
+
+    AssetManager();
+
+    void startup(ThreadPool* threadPool, Loader loader);
+
+    // Waits for in-flight loads so no worker outlives the manager
+    void shutdown();
+
+    Handle requestModel(const std::string& path);
+    State getState(Handle handle) const;
+
+    // True while any request is loading or waiting to be taken
+    bool isBusy() const;
+
+    // Hands over one loaded model, oldest first. Returns false if none is ready.
+    bool takeLoaded(Handle& handle, ModelData& modelData);
+    void markResident(Handle handle);
+
+    // Forgets the handle; a load still in flight is discarded when it finishes
+    void release(Handle handle);
+
+private:
+    struct Request {
+        std::string path;
+        State state;
+    };
+
+    void load(Handle handle, std::string path);
+
+    ThreadPool* threadPool;
+    Loader loader;
+    std::map<Handle, Request> requests;
+    std::deque<std::pair<Handle, ModelData>> loaded;
+    Handle nextHandle;
+    int loadsInFlight;
+    mutable std::mutex mutex;
+    std::condition_variable loadFinished;
+};
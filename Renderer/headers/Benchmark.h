@@ -0,0 +1,12 @@
+#pragma once
+#include <string>
+
+namespace Benchmark {
+    // Imports every .glb in the directory and reports vertex fill time (reference vs. fast path)
+    // in milliseconds per million vertices. Runs on the CPU only, no GL context required.
+    void runImportBenchmark(const std::string& modelDirectory);
+
+    // Times vmath's mat4 multiply, transpose, inverse and mat4 x vec4 against scalar reference
+    // loops and checks they agree within tolerance. Compares the SSE path when built with VMATH_SIMD.
+    void runVmathBenchmark();
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "vmath.h"
+#include "ModelData.h"
+#include <xmmintrin.h>
+
+// View frustum planes in SoA form, tested four planes per SSE instruction.
+// Bounds are tested in mesh space against a model matrix: first the bounding sphere as a
+// cheap reject, then the world-space box enclosing the transformed AABB.
+class Frustum {
+public:
+    // Gribb/Hartmann plane extraction from a column-major clip matrix (projection * view)
+    void extract(const vmath::mat4& viewProjection);
+
+    bool isVisible(const BoundingVolume& bounds, const vmath::mat4& modelMatrix) const;
+
+    // World-space sphere only
+    bool isSphereVisible(const vmath::vec3& center, float radius) const;
+
+    // The six normalized planes as (a, b, c, d), for testing on the GPU
+    void getPlanes(vmath::vec4 planes[6]) const;
+
+private:
+    // Six planes padded to eight by repeating the last one; ax + by + cz + d >= 0 is inside
+    __m128 planeX[2];
+    __m128 planeY[2];
+    __m128 planeZ[2];
+    __m128 planeD[2];
+};
@@ -0,0 +1,90 @@
+#pragma once
+#include "SharedUtilities.h"
+#include "UploadRing.h"
+#include <map>
+#include <vector>
+
+struct VertexAttribute {
+    GLuint location;
+    GLint components;
+    GLenum type;
+    GLboolean normalized;
+    GLuint offset;
+};
+
+struct VertexFormat {
+    GLsizei stride;
+    std::vector<VertexAttribute> attributes;
+};
+
+// Best-fit free-list over [0, capacity) in element units; freed ranges are coalesced with their neighbours
+class RangeAllocator {
+public:
+    RangeAllocator() : capacity(0) {}
+
+    void reset(unsigned int initialCapacity);
+    bool allocate(unsigned int count, unsigned int& offset);
+    void free(unsigned int offset, unsigned int count);
+    void grow(unsigned int newCapacity);
+
+    unsigned int getCapacity() const { return capacity; }
+    unsigned int getLargestFreeRange() const;
+
+private:
+    std::map<unsigned int, unsigned int> freeRanges; // offset -> count
+    unsigned int capacity;
+};
+
+// One vertex buffer shared by every mesh of a vertex format, plus one index buffer per index type.
+// Indices are relative to baseVertex, so a mesh of up to 65536 vertices is stored with 16-bit
+// indices. Each index type has its own VAO over the shared vertex buffer; draws bind the VAO of
+// their mesh's type. Meshes own (baseVertex, firstIndex) sub-ranges that can be freed and reused at
+// runtime. Buffers grow by doubling; uploads still queued in the UploadRing are retargeted.
+class GeometryArena {
+public:
+    static const unsigned int kMaxShortIndexVertices = 65536;
+
+    struct Range {
+        unsigned int baseVertex;
+        unsigned int vertexCount;
+        unsigned int firstIndex; // In units of indexType, within that type's index buffer
+        unsigned int indexCount;
+        GLenum indexType; // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    };
+
+    static GLenum selectIndexType(unsigned int vertexCount);
+    static size_t getIndexSize(GLenum indexType);
+
+    GeometryArena();
+
+    void startup(const VertexFormat& format, unsigned int vertexCapacity, unsigned int indexCapacity, UploadRing* uploadRing);
+    void shutdown();
+
+    bool allocate(unsigned int vertexCount, unsigned int indexCount, Range& range);
+    void free(const Range& range);
+
+    // Queues vertex data (vertexCount * stride bytes) and 32-bit indices for an allocated range;
+    // the indices are narrowed when the range is 16-bit
+    UploadRing::Ticket upload(const Range& range, const void* vertices, const unsigned int* indices);
+
+    GLuint getVAO(GLenum indexType) const { return getPool(indexType).vao; }
+
+private:
+    struct IndexPool {
+        GLenum type;
+        GLuint vao;
+        GLuint buffer;
+        RangeAllocator allocator;
+    };
+
+    IndexPool& getPool(GLenum indexType) { return indexPools[indexType == GL_UNSIGNED_SHORT ? 0 : 1]; }
+    const IndexPool& getPool(GLenum indexType) const { return indexPools[indexType == GL_UNSIGNED_SHORT ? 0 : 1]; }
+    void growVertexBuffer(unsigned int minCapacity);
+    void growIndexBuffer(IndexPool& pool, unsigned int minCapacity);
+
+    VertexFormat format;
+    UploadRing* uploadRing;
+    GLuint vertexBuffer;
+    RangeAllocator vertexAllocator;
+    IndexPool indexPools[2]; // 16-bit, 32-bit
+};
@@ -0,0 +1,111 @@
+#pragma once
+#include "SharedUtilities.h"
+#include "vmath.h"
+#include "Frustum.h"
+#include "GeometryArena.h"
+#include "ModelData.h"
+#include <vector>
+
+// Frustum culling of every mesh instance in a compute shader (shaders/cull.cs.glsl). One draw
+// record per mesh is uploaded when the scene changes; each frame one workgroup per record tests
+// the record's instances, writes the visible ones to a compacted instance list and appends an
+// indirect command, whose count feeds glMultiDrawElementsIndirectCountARB. Records and commands
+// are split by index type, each with its own count and multi-draw. The CPU cost per
+// frame doesn't depend on the number of meshes or instances.
+//
+// Each record also carries its mesh's LOD ranges; the workgroup picks the level from its nearest
+// visible instance, with the same rule and hysteresis as LevelOfDetail::selectLod, and keeps the
+// pick in the record for the next frame.
+//
+// The shader also reports draw statistics and the largest on-screen size of each material.
+// Those are read back kReadbackFrames later, once the GPU is done with them, so reading never stalls.
+class GpuCulling {
+public:
+    static const GLuint kRecordBinding = 3;
+    static const GLuint kCommandBinding = 4;
+    static const GLuint kCommandRecordBinding = 5;
+    static const GLuint kVisibleInstanceBinding = 6;
+    static const GLuint kDrawCountBinding = 7;
+    static const GLuint kFeedbackBinding = 8;
+    static const int kReadbackFrames = 3;
+
+    // std430 layout of DrawRecordBuffer in cull.cs.glsl and texturedCulled.vs.glsl
+    struct DrawRecord {
+        vmath::mat4 modelMatrix;
+        vmath::vec4 sphere; // Mesh-space bounding sphere: center, radius
+        vmath::vec4 positionDequant;
+        GLint baseVertex;
+        GLuint materialIndex;
+        GLuint firstInstance; // Range in the InstanceBuffer
+        GLuint instanceCount;
+        GLuint outputOffset;  // Range in the visible instance list, sized instanceCount
+        GLuint wideIndices;   // 1 for GL_UNSIGNED_INT, 0 for GL_UNSIGNED_SHORT
+        GLuint lodCount;
+        GLuint lod;           // Level drawn last frame, written by the shader
+        GLuint lodFirstIndex[kMaxLods]; // In the arena's index buffer
+        GLuint lodIndexCount[kMaxLods];
+        float lodError[kMaxLods];
+        GLuint padding;
+    };
+
+    // Results of a finished frame
+    struct Feedback {
+        unsigned int drawCount;
+        unsigned int visibleInstances;
+        unsigned long long triangles;
+        unsigned int culledRecords; // Records with no visible instance
+        std::vector<float> materialSizes; // Largest on-screen size in pixels, indexed by material ID
+    };
+
+    GpuCulling();
+
+    // Compute shaders, glMultiDrawElementsIndirectCountARB and gl_DrawIDARB / gl_BaseInstanceARB
+    static bool isSupported();
+
+    void startup();
+    void shutdown();
+
+    // Replaces the draw records, which list every 16-bit record before the 32-bit ones. Offsets
+    // into the visible instance list are assigned here.
+    void setRecords(std::vector<DrawRecord>& records);
+
+    // Runs the culling pass. projScale is projMatrix[1][1] * viewport height.
+    void cull(const Frustum& frustum, const vmath::mat4& viewMatrix, const vmath::mat4& animationMatrix,
+        float projScale, float screenHeight, GLuint materialCount);
+
+    // Binds the pass's output for the draw shader and issues one multi-draw per index type through
+    // the arena's VAOs. drawOffsetLocation receives the first command of each multi-draw. Adds the
+    // binds issued to bindCount and returns the number of multi-draws.
+    int draw(const GeometryArena& geometryArena, GLint drawOffsetLocation, int& bindCount);
+
+    // Oldest frame whose results have landed, if any
+    bool takeFeedback(Feedback& feedback);
+
+private:
+    struct FeedbackSlot {
+        GLuint buffer;
+        GLuint materialCount; // Entries the buffer holds after its header
+        GLsync fence;
+    };
+
+    GLuint program;
+    GLint viewLocation;
+    GLint animationLocation;
+    GLint planesLocation;
+    GLint projScaleLocation;
+    GLint screenHeightLocation;
+    GLint wideCommandStartLocation;
+    GLint maxPixelErrorLocation;
+    GLint lodHysteresisLocation;
+
+    GLuint recordBuffer;
+    GLuint commandBuffer;
+    GLuint commandRecordBuffer;
+    GLuint visibleInstanceBuffer;
+    GLuint drawCountBuffer;
+    GLuint recordCount;
+    GLuint shortRecordCount; // Commands of 32-bit records start here
+
+    FeedbackSlot feedbackSlots[kReadbackFrames];
+    int nextSlot;
+};
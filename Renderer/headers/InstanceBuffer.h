@@ -0,0 +1,40 @@
+#pragma once
+#include "SharedUtilities.h"
+#include "vmath.h"
+#include "GeometryArena.h"
+#include <vector>
+
+// Per-instance transforms of every GameObject in one SSBO (binding 2). Objects own consecutive
+// ranges; the shaders read instances[firstInstance + gl_InstanceID]. A CPU copy is kept, so
+// moving an instance only marks it dirty and flush() uploads the span of changed entries.
+// The buffer grows by doubling and is re-uploaded whole when it does.
+class InstanceBuffer {
+public:
+    static const GLuint kBufferBinding = 2;
+
+    InstanceBuffer();
+
+    void startup(unsigned int initialCapacity);
+    void shutdown();
+
+    // Reserves count consecutive instances, each starting as the identity
+    bool allocate(unsigned int count, unsigned int& first);
+    void free(unsigned int first, unsigned int count);
+
+    void setTransform(unsigned int index, const vmath::mat4& transform);
+    const vmath::mat4& getTransform(unsigned int index) const { return transforms[index]; }
+
+    // Uploads the instances changed since the last flush; returns the bytes uploaded
+    size_t flush();
+
+    void bind() const;
+
+private:
+    void grow(unsigned int minCapacity);
+
+    RangeAllocator allocator;
+    std::vector<vmath::mat4> transforms; // Sized to the allocator's capacity
+    GLuint buffer;
+    unsigned int dirtyBegin;
+    unsigned int dirtyEnd;
+};
@@ -0,0 +1,15 @@
+#pragma once
+#include "ModelData.h"
+#include <stddef.h>
+
+// KTX2 container reader for textures embedded through KHR_texture_basisu. Payloads already in a
+// format the renderer uploads (RGB8/RGBA8, BC1, BC5, BC7; sRGB variants read as UNORM like every
+// other texture) are taken as-is, keeping the file's mip chain. Basis Universal payloads (BasisLZ
+// or UASTC) and Zstandard/ZLIB supercompression need a transcoder this build doesn't link, so
+// those files are rejected with a message.
+namespace Ktx2 {
+    bool isKtx2(const unsigned char* data, size_t size);
+
+    // Returns false for malformed files and payloads that can't be used directly
+    bool load(const unsigned char* data, size_t size, TextureData& textureData);
+}
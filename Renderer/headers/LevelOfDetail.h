@@ -0,0 +1,27 @@
+#pragma once
+#include "ModelData.h"
+#include <vector>
+
+// Import-time LOD chains and their selection at draw time.
+//
+// Levels are built by collapsing edges onto existing vertices, ordered by a quadric error metric
+// plus a penalty for the change in normal, so each level is only an index list over the mesh's
+// own vertices. Vertices on a UV or normal seam (several vertices at one position) only move along
+// the seam, together with their twin, and vertices on an open border only along the border.
+namespace LevelOfDetail {
+    const float kMaxPixelError = 1.0f; // A level is drawn while its error covers at most this many pixels
+    const float kHysteresis = 0.75f;   // A coarser level must be this far under the limit before it is picked
+
+    // Collapses edges of a MeshImport float-layout mesh until about targetIndexCount indices remain
+    // or every remaining collapse would cost more than maxError. Returns the largest error taken,
+    // in mesh units. Thread-safe.
+    float simplify(const std::vector<float>& vertices, const std::vector<unsigned int>& indices,
+        size_t targetIndexCount, float maxError, std::vector<unsigned int>& result);
+
+    // Makes the current indices level 0 and appends up to kMaxLods - 1 coarser levels. Thread-safe.
+    void buildLods(MeshData& mesh);
+
+    // Level to draw, starting from the one drawn last. pixelsPerUnit is the screen size of one mesh
+    // unit at the nearest point of the mesh; shaders/cull.cs.glsl makes the same choice.
+    int selectLod(const MeshLod* lods, int lodCount, int currentLod, float pixelsPerUnit);
+}
@@ -0,0 +1,164 @@
+#pragma once
+#include "SharedUtilities.h"
+#include "ModelData.h"
+#include "UploadRing.h"
+#include <map>
+#include <tuple>
+#include <vector>
+
+// Owns every texture and material the renderer draws with. Materials live in a GPU-side table
+// (SSBO binding 1) indexed by material ID, so the shaders pick their textures per draw and no
+// texture is bound per mesh.
+//
+// Textures are packed into GL_TEXTURE_2D_ARRAY layers, one array per size/format/mip count, bound
+// once to units [0, kMaxTextureArrays). With GL_ARB_bindless_texture and GL_NV_gpu_shader5 (for
+// handles that vary within a multi-draw) every texture instead stays a plain GL_TEXTURE_2D and the
+// table stores resident handles.
+//
+// Each texture keeps its full mip chain on the CPU so it can be re-created starting at a
+// lower-resolution level and streamed back up later (see TextureResidency). The old copy keeps
+// being drawn until the new one's upload has landed, and is freed once no frame in flight can
+// still read it. An array's storage is only freed when all its layers are free. Level changes
+// never take the last kReservedArraySlots array slots, so they can't starve later loads.
+class MaterialSystem {
+public:
+    static const int kMaxTextureArrays = 16;
+    static const int kReservedArraySlots = 4; // Slots only addTextures may fill
+    static const int kMaterialBufferBinding = 1;
+    static const unsigned long long kRetireFrames = 3; // Frames a replaced texture copy is kept alive
+
+    MaterialSystem();
+
+    void startup(UploadRing* uploadRing, bool allowBindless);
+    void shutdown();
+
+    bool isBindless() const { return bindless; }
+
+    // Returns one texture ID per input texture (-1 if it could not be placed). Textures with a
+    // content hash that is already loaded in the same format share its ID and gain a reference.
+    std::vector<int> addTextures(const std::vector<TextureData>& textures);
+
+    // Drops one reference; returns true if that was the last and the texture is gone
+    bool releaseTexture(int textureId);
+
+    // Texture IDs may be -1 for maps the material doesn't use
+    GLuint addMaterial(int diffuseTexture, int normalTexture);
+    void releaseMaterial(GLuint materialId);
+
+    // Texture IDs of a material's maps, -1 when unused
+    void getMaterialTextures(GLuint materialId, int& diffuseTexture, int& normalTexture) const;
+    GLuint getMaterialCount() const { return (GLuint)materials.size(); } // One past the highest material ID
+
+    int getLevelCount(int textureId) const;
+    int getArrayCount() const; // Array slots holding storage
+    int getDroppedTextureCount() const { return droppedTextureCount; } // Textures addTextures could not place
+    int getDeferredLevelChangeCount() const { return deferredLevelChangeCount; } // Level changes refused for lack of a slot
+
+    int getLargestDimension(int textureId) const;
+
+    // First (largest) mip on the GPU, or the one a pending change will switch to
+    int getFirstLevel(int textureId) const;
+    bool isLevelChangePending(int textureId) const;
+
+    // GPU bytes of the texture when it starts at firstLevel
+    size_t getTextureBytes(int textureId, int firstLevel) const;
+
+    // Re-creates the texture starting at firstLevel. Returns false if a change is already
+    // pending or the new copy would need one of the reserved array slots; the caller can retry later.
+    bool requestFirstLevel(int textureId, int firstLevel);
+
+    // Once per frame: swaps in level changes whose uploads have landed and frees retired copies
+    void update();
+
+    // Uploads the material table if it changed and binds it with the texture arrays.
+    // Returns the number of texture and buffer binds issued.
+    int bind(GLint textureArraysLocation);
+
+private:
+    struct TextureArray {
+        GLuint texture; // 0 once every layer was freed; the slot is reused
+        GLsizei width;
+        GLsizei height;
+        GLsizei levels;
+        GLenum internalFormat;
+        GLsizei capacity;
+        std::vector<GLint> freeLayers;
+    };
+
+    // Where one GPU copy of a texture lives
+    struct Placement {
+        GLint array;       // Texture-array mode
+        GLint layer;
+        GLuint texture;    // Bindless mode
+        GLuint64 handle;
+        UploadRing::Ticket ticket; // Last upload into the copy; it is only freed once this is submitted
+    };
+
+    struct TextureRecord {
+        bool used;
+        unsigned int refCount;
+        Placement placement;
+        int firstLevel;
+        TextureData source; // Full mip chain
+    };
+
+    struct LevelChange {
+        int textureId;
+        int firstLevel;
+        Placement placement;
+    };
+
+    struct RetiredPlacement {
+        Placement placement;
+        unsigned long long frame;
+    };
+
+    struct MaterialRecord {
+        bool used;
+        int diffuseTexture;
+        int normalTexture;
+    };
+
+    // std430 layout of one material table entry; both modes are 16 bytes
+    struct ArrayMaterialEntry {
+        GLint diffuseArray;
+        GLint diffuseLayer;
+        GLint normalArray;
+        GLint normalLayer;
+    };
+
+    struct BindlessMaterialEntry {
+        GLuint64 diffuseHandle;
+        GLuint64 normalHandle;
+    };
+
+    // Content hash, format, size and mip count: textures that match are interchangeable
+    typedef std::tuple<unsigned long long, int, int, int, size_t> ContentKey;
+
+    static ContentKey getContentKey(const TextureData& texture);
+    int findShared(const TextureData& texture) const;
+    int findArray(GLsizei width, GLsizei height, GLenum internalFormat, GLsizei levels, GLsizei layersNeeded, int reservedSlots);
+    bool place(const TextureData& texture, int firstLevel, GLsizei layersNeeded, int reservedSlots, Placement& placement);
+    void placeInArray(const TextureData& texture, int firstLevel, Placement& placement);
+    void placeBindless(const TextureData& texture, int firstLevel, Placement& placement);
+    UploadRing::Ticket uploadMips(const TextureData& texture, int firstLevel, GLuint target, GLenum textureType, GLint layer);
+    void freePlacement(const Placement& placement);
+    void retirePlacement(const Placement& placement);
+    void updateMaterialBuffer();
+
+    UploadRing* uploadRing;
+    bool bindless;
+    std::vector<TextureArray> arrays;
+    std::vector<TextureRecord> textures;
+    std::vector<MaterialRecord> materials;
+    std::vector<int> freeTextureIds;
+    std::map<ContentKey, int> sharedTextures;
+    std::vector<GLuint> freeMaterialIds;
+    std::vector<LevelChange> levelChanges;
+    std::vector<RetiredPlacement> retiredPlacements;
+    unsigned long long frameIndex;
+    int droppedTextureCount;
+    int deferredLevelChangeCount;
+    GLuint materialBuffer;
+    bool materialsDirty;
+};
@@ -0,0 +1,28 @@
+#pragma once
+#include "ModelData.h"
+#include <string>
+
+// Binary pre-baked model cache written next to the source asset (<model>.meshcache).
+// Entries are keyed by a hash of the source file, its size, the Assimp import flags and the
+// format version; any mismatch makes load() fail so the caller re-imports and re-saves.
+namespace MeshCache {
+    const unsigned int kVersion = 8;
+
+    struct Key {
+        unsigned long long sourceHash;
+        unsigned long long sourceSize;
+        unsigned int importFlags;
+    };
+
+    std::string getCachePath(const std::string& sourcePath);
+
+    // FNV-1a over 64-bit words; also keys embedded textures by content
+    unsigned long long hashBytes(const unsigned char* data, size_t size);
+
+    // Hashes the source asset through a read-only mapping. Returns false if it cannot be opened.
+    bool computeKey(const std::string& sourcePath, unsigned int importFlags, Key& key);
+
+    // Memory-maps the cache file and fills modelData. Returns false if missing, stale or corrupt.
+    bool load(const std::string& cachePath, const Key& key, ModelData& modelData);
+    bool save(const std::string& cachePath, const Key& key, const ModelData& modelData);
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "ModelData.h"
+#include <assimp/mesh.h>
+#include <assimp/texture.h>
+#include <assimp/postprocess.h>
+#include <vector>
+
+namespace MeshImport {
+    // Flags passed to Assimp::Importer::ReadFile, also part of the MeshCache key
+    const unsigned int kImportFlags = aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_JoinIdenticalVertices;
+
+    // Interleaved layout: position (3), normal (3), tangent (3), uv (2)
+    const int kFloatsPerVertex = 3 + 3 + 3 + 2;
+
+    // Which optional attributes an aiMesh provides, used to pick a fill kernel once per mesh
+    enum AttributeFlags {
+        Attribute_Normals = 1 << 0,
+        Attribute_Tangents = 1 << 1,
+        Attribute_TexCoords = 1 << 2,
+        Attribute_Count = 1 << 3
+    };
+
+    typedef void (*FillVerticesKernel)(const aiMesh* mesh, float* out);
+
+    unsigned int getAttributeFlags(const aiMesh* mesh);
+    FillVerticesKernel selectFillKernel(unsigned int attributeFlags);
+
+    // Sizes the output once from mNumVertices / mNumFaces and fills it with the selected kernel
+    void fillVertices(const aiMesh* mesh, std::vector<float>& vertices);
+    void fillIndices(const aiMesh* mesh, std::vector<unsigned int>& indices);
+
+    // Splits a mesh into parts of at most maxVertices vertices each, keeping triangle order.
+    // Parts share the mesh's node and textures and get their own bounds. Thread-safe.
+    void splitMesh(const MeshData& mesh, unsigned int maxVertices, std::vector<MeshData>& parts);
+
+    // Decodes a compressed (PNG/JPEG) embedded texture and builds its mip chain. RGB stays RGB,
+    // everything else is expanded to RGBA. KTX2 files go through Ktx2::load instead.
+    // Thread-safe; returns false if the image can't be decoded.
+    bool decodeTexture(const aiTexture* texture, TextureData& textureData);
+
+    // Original per-vertex push_back loop, kept as the baseline for the import benchmark
+    void fillVerticesReference(const aiMesh* mesh, std::vector<float>& vertices);
+}
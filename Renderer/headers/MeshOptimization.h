@@ -0,0 +1,27 @@
+#pragma once
+#include <stddef.h>
+#include <vector>
+
+// Import-time reordering of triangle lists for the GPU, baked into the MeshCache:
+//   1. Tipsify (Sander et al. 2007) orders triangles for the post-transform vertex cache
+//   2. The result is cut into clusters, which are sorted outward-facing first so that, from most
+//      views, nearer surfaces are drawn before the ones they hide
+//   3. Vertices are renumbered in first-use order so fetches walk the vertex buffer forward
+// All functions are thread-safe.
+namespace MeshOptimization {
+    const unsigned int kCacheSize = 16; // FIFO entries assumed by the optimizer and the statistics
+
+    // Average cache miss ratio per triangle (ACMR, 0.5 is ideal) and per vertex (ATVR, 1.0 is ideal)
+    struct CacheStats {
+        float acmr;
+        float atvr;
+    };
+
+    CacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount);
+
+    // Steps 1 and 2; vertices are read for cluster positions and normals only
+    void optimizeTriangleOrder(std::vector<unsigned int>& indices, const std::vector<float>& vertices, int floatsPerVertex);
+
+    // Step 3; vertices no triangle uses are dropped
+    void optimizeVertexFetch(std::vector<float>& vertices, int floatsPerVertex, std::vector<unsigned int>& indices);
+}
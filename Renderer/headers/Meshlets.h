@@ -0,0 +1,27 @@
+#pragma once
+#include "ModelData.h"
+#include "Frustum.h"
+#include <vector>
+
+// Meshlets cut from level 0 at import, culled per instance at draw time. Level 0 is already in
+// vertex cache order (MeshOptimization), so a meshlet is simply the next run of triangles until a
+// limit is hit; the indices aren't touched and visible neighbours merge back into one range.
+namespace Meshlets {
+    const unsigned int kMaxVertices = 64;
+    const unsigned int kMaxTriangles = 124;
+
+    // Range of a mesh's indices, relative to its first index
+    struct IndexRange {
+        unsigned int firstIndex;
+        unsigned int indexCount;
+    };
+
+    // Replaces mesh.meshlets with meshlets covering level 0. Thread-safe.
+    void build(MeshData& mesh);
+
+    // Appends the ranges of the meshlets that intersect the frustum and don't face entirely away
+    // from the camera, merging adjacent ones. The cone test is skipped for non-uniformly scaled
+    // matrices, which don't preserve it. Returns the number of meshlets culled. Thread-safe.
+    size_t cull(const std::vector<Meshlet>& meshlets, const vmath::mat4& modelMatrix, const Frustum& frustum,
+        const vmath::vec3& cameraPosition, std::vector<IndexRange>& ranges);
+}
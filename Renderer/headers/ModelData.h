@@ -0,0 +1,87 @@
+#pragma once
+#include "vmath.h"
+#include <vector>
+
+// CPU-side result of importing a model, before any GL objects exist.
+// Produced either by Assimp (Renderer::importModel) or by reading a MeshCache file.
+
+// Layout of TextureData::mips. Block formats store 4x4 blocks row by row, edge blocks padded.
+enum TextureFormat {
+    TextureFormat_RGB8,
+    TextureFormat_RGBA8,
+    TextureFormat_BC1, // Opaque color, 8 bytes per block
+    TextureFormat_BC5, // Two-channel normal map (X, Y), 16 bytes per block
+    TextureFormat_BC7, // Color with alpha, 16 bytes per block
+    TextureFormat_Count
+};
+
+struct TextureData {
+    int width;
+    int height;
+    int channels; // Of the decoded image: 3 (RGB) or 4 (RGBA)
+    TextureFormat format;
+    unsigned long long contentHash; // Of the embedded file bytes, 0 if unknown; shares GPU copies across models
+    std::vector<std::vector<unsigned char>> mips; // Level 0 first, down to 1x1
+};
+
+// Mesh-space bounds, transformed per draw for culling
+struct BoundingVolume {
+    vmath::vec3 aabbMin;
+    vmath::vec3 aabbMax;
+    vmath::vec3 sphereCenter;
+    float sphereRadius;
+};
+
+// One node of the imported hierarchy. Nodes are stored parents-first, so parent < own index.
+struct NodeData {
+    int parent; // -1 for the root
+    vmath::vec3 translation;
+    vmath::vec4 rotation; // Unit quaternion (x, y, z, w)
+    vmath::vec3 scale;
+};
+
+const int kMaxLods = 5;
+
+// One level of detail: a range of MeshData::indices over the mesh's shared vertices. Level 0 is
+// the full mesh; each further level has about half the triangles of the one before.
+struct MeshLod {
+    unsigned int firstIndex;
+    unsigned int indexCount;
+    float error; // How far the level may stray from level 0's surface, in mesh units
+};
+
+// A run of level 0's triangles, contiguous in MeshData::indices, with bounds for culling it on its
+// own (see Meshlets)
+struct Meshlet {
+    unsigned int firstIndex;
+    unsigned int indexCount;
+    vmath::vec3 center; // Mesh-space bounding sphere
+    float radius;
+    vmath::vec3 coneAxis; // Average triangle normal
+    float coneCutoff;     // Sine of the normal cone's half angle; 1 when the cone can never be culled
+};
+
+struct MeshData {
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices; // Every level of lods, level 0 first
+    std::vector<MeshLod> lods;
+    std::vector<Meshlet> meshlets; // Covering level 0
+    std::vector<unsigned char> packedVertices; // VertexQuantization compact layout, filled after loading (not cached)
+    vmath::vec4 positionDequant; // Packed position to mesh space: p * w + xyz
+    int diffuseTexture; // Index into ModelData::textures, -1 when unused
+    int normalTexture;
+    int node; // Index into ModelData::nodes
+    BoundingVolume bounds;
+};
+
+struct ModelData {
+    std::vector<NodeData> nodes;
+    std::vector<MeshData> meshes;
+    std::vector<TextureData> textures;
+};
+
+// Box-filters level 0 down to 1x1, replacing any existing lower levels
+void buildMipChain(TextureData& texture);
+
+// AABB of the positions (first three floats of each vertex) and a sphere around the AABB center
+BoundingVolume computeBounds(const std::vector<float>& vertices, int floatsPerVertex);
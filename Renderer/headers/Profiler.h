@@ -0,0 +1,103 @@
+#pragma once
+#include "SharedUtilities.h"
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Frame profiler: scoped CPU zones, GL_TIME_ELAPSED queries around GPU passes and per-frame
+// counters, each kept as a rolling history so percentiles can be reported and exported.
+//
+// GPU queries are cycled over kFramesInFlight sets and only read back once
+// GL_QUERY_RESULT_AVAILABLE says so, so reading them never stalls the pipeline. GPU zones
+// must not nest since only one GL_TIME_ELAPSED query can be active at a time.
+class Profiler {
+public:
+    static const int kFramesInFlight = 3;
+    static const size_t kHistoryFrames = 1024;
+
+    enum Counter {
+        Counter_DrawCalls,
+        Counter_StateChanges, // Program, VAO, texture and buffer binds
+        Counter_Triangles,
+        Counter_UploadBytes,
+        Counter_CulledMeshes,
+        Counter_CulledMeshlets,
+        Counter_Count
+    };
+
+    typedef int Zone;
+
+    Profiler();
+
+    void startup();
+    void shutdown();
+
+    // GPU timing is only recorded for zones registered with gpu set
+    Zone addZone(const std::string& name, bool gpu);
+
+    void beginFrame();
+    void endFrame();
+
+    void beginZone(Zone zone);
+    void endZone(Zone zone);
+
+    void addCount(Counter counter, unsigned long long value) { frameCounters[counter] += value; }
+
+    // One row per metric: name, p50, p95, p99, mean, sample count
+    bool exportCsv(const std::string& path) const;
+    void writeCsv(FILE* file) const;
+
+    // Short single-line summary of the latest percentiles, e.g. for the window title
+    std::string getSummary() const;
+
+private:
+    typedef std::chrono::high_resolution_clock Clock;
+
+    // Rolling window of the last kHistoryFrames samples
+    struct Series {
+        std::string name;
+        std::vector<double> samples;
+        size_t next;
+        size_t count;
+
+        void add(double value);
+        double getPercentile(double percentile) const;
+        double getMean() const;
+    };
+
+    struct ZoneRecord {
+        bool gpu;
+        Clock::time_point cpuStart;
+        double cpuMilliseconds; // Accumulated this frame
+        GLuint queries[kFramesInFlight];
+        bool queryIssued[kFramesInFlight];
+        size_t cpuSeries;
+        size_t gpuSeries;
+    };
+
+    size_t addSeries(const std::string& name);
+    void collectQueries(int slot);
+
+    std::vector<ZoneRecord> zones;
+    std::vector<Series> series;
+    size_t frameSeries;
+    size_t counterSeries[Counter_Count];
+    unsigned long long frameCounters[Counter_Count];
+    Clock::time_point frameStart;
+    bool frameStarted;
+    int frameSlot;
+};
+
+// Times the enclosing scope as the given zone
+class ProfileScope {
+public:
+    ProfileScope(Profiler& profiler, Profiler::Zone zone) : profiler(profiler), zone(zone) { profiler.beginZone(zone); }
+    ~ProfileScope() { profiler.endZone(zone); }
+
+private:
+    ProfileScope(const ProfileScope&);
+    ProfileScope& operator=(const ProfileScope&);
+
+    Profiler& profiler;
+    Profiler::Zone zone;
+};
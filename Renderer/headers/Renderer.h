@@ -1,6 +1,20 @@
 #pragma once
 #include "SharedUtilities.h"
 #include "vmath.h"
+#include "ModelData.h"
+#include "UploadRing.h"
+#include "GeometryArena.h"
+#include "MaterialSystem.h"
+#include "TextureResidency.h"
+#include "InstanceBuffer.h"
+#include "GpuCulling.h"
+#include "VertexQuantization.h"
+#include "MeshOptimization.h"
+#include "Meshlets.h"
+#include "Profiler.h"
+#include "SceneGraph.h"
+#include "ThreadPool.h"
+#include "AssetManager.h"
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
@@ -8,24 +22,73 @@
 #include <vector>
 #include <map>
 
-struct Material {
-    int diffuseTextureId; // Using -1 for meshes that don't use this texture
-    int normalTextureId;
+struct Mesh {
+    GeometryArena::Range geometry; // Sub-range of the shared vertex/index buffers
+    GLuint materialIndex; // Entry in the MaterialSystem table
+    SceneGraph::Node node;
+    vmath::mat4 modelMatrix; // World matrix of node, refreshed when the scene graph updates it
+    vmath::vec4 positionDequant; // Vertex position to mesh space: p * w + xyz, applied before modelMatrix
+    BoundingVolume bounds; // Mesh space, transformed by modelMatrix when culling
+    UploadRing::Ticket uploadTicket; // Drawable once the upload ring has submitted this ticket
+    unsigned int firstInstance; // The owning GameObject's range in the InstanceBuffer
+    unsigned int instanceCount;
+    MeshLod lods[kMaxLods]; // Index ranges relative to geometry.firstIndex, level 0 first
+    int lodCount;
+    int lod; // Level picked by the last cullMeshes, where the next selection starts
+    std::vector<Meshlet> meshlets; // Over level 0, relative to geometry.firstIndex
 };
 
-struct Mesh {
-    std::vector<float> vertices;
-    std::vector<unsigned int> indices;
-    GLuint VAO, VBO, EBO;
-    Material material;
+// Layout fixed by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// std430 layout of DrawDataBuffer in texturedIndirect.vs.glsl
+struct DrawData {
     vmath::mat4 modelMatrix;
+    vmath::vec4 positionDequant;
+    GLuint materialIndex;
+    GLuint firstInstance;
+    GLuint padding[2];
+};
+
+enum RenderMode {
+    RenderMode_Direct,   // One glDrawElementsBaseVertex per mesh
+    RenderMode_Indirect, // Per-draw data in an SSBO, one glMultiDrawElementsIndirect per gameObject
+    RenderMode_GpuCulled, // Culled per instance in a compute pass, drawn with glMultiDrawElementsIndirectCountARB
+    RenderMode_Meshlets   // Level 0 culled per meshlet on the thread pool each frame, drawn like Indirect
 };
 
 struct GameObject {
     std::vector<Mesh> meshes;
+    std::vector<int> textureIds;    // MaterialSystem textures and materials owned by this object,
+    std::vector<GLuint> materialIds; // released by unloadGameObject
+    SceneGraph::Node rootNode = 0; // Placement node, followed by the model's nodeCount - 1 nodes
+    int nodeCount = 0;
+    AssetManager::Handle handle = AssetManager::kInvalidHandle;
+    unsigned int firstInstance = 0; // Every mesh is drawn once per instance
+    unsigned int instanceCount = 0;
     vmath::mat4 transformMatrix;
 };
 
+// Chosen at startup and fixed while the geometry arena lives
+struct GeometrySettings {
+    VertexQuantization::VertexLayout vertexLayout;
+    bool shortIndicesOnly; // Split meshes over 65536 vertices so every mesh draws with 16-bit indices
+};
+
+// Assimp data gathered while walking the scene, converted in parallel afterwards.
+// Entries line up with ModelData::meshes / ModelData::textures.
+struct ImportSources {
+    std::vector<const aiMesh*> meshes;
+    std::vector<const aiTexture*> textures;
+    std::map<std::string, int> textureIndices; // Embedded path ("*0") to ModelData::textures index
+};
+
 class Renderer {
 private:
     int tempCounter = 0;
@@ -37,29 +100,132 @@ private:
     GLint modelLocation;
     GLint viewLocation;
     GLint projLocation;
-    GLint diffuseSamplerLocation;
-    GLint normalSamplerLocation;
-    GLint matValidityCheckLocation;
+    GLint materialIndexLocation;
+    GLint firstInstanceLocation;
+    GLint positionDequantLocation;
+    GLint textureArraysLocation;
     GLint lightDirectionLocation;
     GLint lightColorLocation;
     GLint viewPosLocation;
 
+    // Multi-draw-indirect path
+    RenderMode renderMode;
+    GLuint indirectShaderProgram;
+    GLint indirectViewLocation;
+    GLint indirectProjLocation;
+    GLint indirectAnimationLocation;
+    GLint indirectTextureArraysLocation;
+    GLint indirectLightDirectionLocation;
+    GLint indirectLightColorLocation;
+    GLint indirectViewPosLocation;
+    GLint indirectDrawOffsetLocation;
+    GLuint drawCommandBuffer;
+    GLuint drawDataBuffer;
+    GLsizei indirectDrawCount;
+    GLsizei indirectShortDrawCount; // Leading commands that use 16-bit indices
+    unsigned long long indirectTriangleCount;
+    std::vector<const Mesh*> indirectVisibleMeshes; // Meshes the command buffer was built from
+    bool indirectDirty;
+
+    // Meshlet path; draws through the indirect program and buffers
+    struct MeshletDraws {
+        std::vector<Meshlets::IndexRange> ranges;
+        std::vector<DrawElementsIndirectCommand> commands;
+        std::vector<DrawData> drawData;
+        size_t culled;
+    };
+    std::vector<MeshletDraws> meshletDraws; // One per visible mesh, kept to reuse their storage
+
+    // GPU-culled path
+    GpuCulling gpuCulling;
+    GLuint culledShaderProgram;
+    GLint culledViewLocation;
+    GLint culledProjLocation;
+    GLint culledAnimationLocation;
+    GLint culledTextureArraysLocation;
+    GLint culledLightDirectionLocation;
+    GLint culledLightColorLocation;
+    GLint culledViewPosLocation;
+    GLint culledDrawOffsetLocation;
+    bool cullRecordsDirty;
+
     vmath::mat4 projMatrix;
     vmath::mat4 viewMatrix;
     vmath::vec3 cameraPosition;
-    GameObject gameObject;
-    std::map<std::string, GLuint> currentModelTextureIds; // Could be <int, int> if only loading glbs
-    std::vector<GLuint> allUsedTextureIds;
+    std::vector<const Mesh*> visibleMeshes; // Per-frame culling result, kept to reuse its allocation
+    std::vector<GameObject> gameObjects; // Resident models
+    GeometrySettings geometrySettings; // Of every mesh in the geometry arena
+    InstanceBuffer instanceBuffer;
+    std::map<AssetManager::Handle, std::vector<vmath::mat4>> pendingInstances; // Set before the model was resident
+    UploadRing uploadRing;
+    GeometryArena geometryArena;
+    MaterialSystem materialSystem;
+    TextureResidency textureResidency; // Mip budget on top of materialSystem
+    SceneGraph sceneGraph;
+    ThreadPool threadPool; // CPU-side import work
+    AssetManager assetManager;
+    Profiler profiler;
+    Profiler::Zone uploadZone;
+    Profiler::Zone renderZone;
+    Profiler::Zone swapZone;
+    Profiler::Zone streamZone;
+    Profiler::Zone meshletZone;
 
     void loadShaders(std::string shaderName, GLuint& programId);
-    GLuint loadEmbededTexture(aiMaterial* material, const aiScene* scene, aiTextureType textureType);    GameObject loadModel(const std::string& path);
-    void processNode(aiNode* node, const aiScene* scene, GameObject& gameObject);
-    void processMesh(aiMesh* aiInputMesh, Mesh& outputMesh);
-    vmath::mat4 getGlobalTransform(aiNode* node, const aiScene* scene);
+    void loadShaders(std::string vertexShaderName, std::string fragmentShaderName, GLuint& programId);
+    int loadEmbededTexture(aiMaterial* material, const aiScene* scene, aiTextureType textureType, ModelData& modelData, ImportSources& sources);
+    bool loadModelData(const std::string& path, ModelData& modelData);
+    bool importModel(const std::string& path, ModelData& modelData);
+    void splitMeshes(ModelData& modelData);
+    void quantizeMeshes(const std::string& path, ModelData& modelData);
+    void processNode(aiNode* node, const aiScene* scene, ModelData& modelData, int parent, ImportSources& sources);
+    void processMesh(const aiMesh* aiInputMesh, MeshData& outputMesh,
+        MeshOptimization::CacheStats& cacheBefore, MeshOptimization::CacheStats& cacheAfter);
+    GameObject createGameObject(ModelData& modelData);
+    void uploadMesh(const MeshData& meshData, Mesh& mesh);
+    void unloadGameObject(GameObject& object);
+    void applyInstances(GameObject& object, const std::vector<vmath::mat4>& transforms);
+    void streamAssets();
+    void updateTransforms();
+    void cullMeshes(const vmath::mat4& animationMatrix, std::vector<const Mesh*>& visibleMeshes);
+    float getProjectedSize(const BoundingVolume& bounds, const vmath::mat4& modelMatrix) const;
+    float getPixelsPerUnit(const BoundingVolume& bounds, const vmath::mat4& modelMatrix) const;
+    void renderDirect(double currentTime);
+    void renderIndirect(double currentTime);
+    void buildIndirectDraws();
+    void submitIndirectDraws(const vmath::mat4& animationMatrix);
+    void renderMeshlets(double currentTime);
+    void buildMeshletDraws(const vmath::mat4& animationMatrix);
+    void renderGpuCulled(double currentTime);
+    void buildCullRecords();
 
 public:
-    void startup(int width, int height);
+    void startup(int width, int height, const std::string& modelPath, const GeometrySettings& settings);
     void shutdown();
+
+    // Starts loading in the background and returns immediately; the model is drawn once resident
+    AssetManager::Handle requestModel(const std::string& path);
+    AssetManager::State getModelState(AssetManager::Handle handle) const;
+    void unloadModel(AssetManager::Handle handle);
+
+    // Draws the model once per transform, each applied on top of the model's placement.
+    // A model starts with a single identity instance; moving one instance uploads only that entry.
+    void setInstances(AssetManager::Handle handle, const std::vector<vmath::mat4>& transforms);
+    void setInstanceTransform(AssetManager::Handle handle, unsigned int index, const vmath::mat4& transform);
+
+    // VRAM allowed for texture mips; textures drop or regain mips over the following frames
+    void setTextureBudget(size_t budgetBytes) { textureResidency.setBudget(budgetBytes); }
+    const TextureResidency::Stats& getTextureStats() const { return textureResidency.getStats(); }
+
     void render(double currentTime);
     void runGameLoop(GLFWwindow* window);
+
+    // Renders frameCount frames into an offscreen framebuffer on a fixed camera orbit and timestep,
+    // then prints frame-time percentiles and a checksum of the final image to stdout
+    void runHeadless(int frameCount, double timeStep);
+
+    // Drops the texture budget to zero and restores it cycleCount times, then loads modelPath. Prints
+    // how often every texture reached its smallest mip, how many level changes had no array slot,
+    // the slots in use and how many textures the load could not place.
+    void runBudgetCycle(const std::string& modelPath, int cycleCount);
 };
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+#include "vmath.h"
+#include <vector>
+
+// Node transforms stored as structure-of-arrays in topological order (a parent always precedes
+// its children). update() walks the arrays once, starting at the first dirty node, and only
+// recomputes world matrices for dirty nodes and their descendants.
+class SceneGraph {
+public:
+    typedef int Node;
+
+    SceneGraph();
+
+    // Parent must already exist (or be -1), which keeps the arrays topologically sorted
+    Node addNode(Node parent, const vmath::vec3& translation, const vmath::vec4& rotation, const vmath::vec3& scale);
+
+    // Removes a contiguous range of nodes with no children outside it; later nodes move down by count
+    void removeNodes(Node first, int count);
+    void clear();
+
+    // Rotation is a unit quaternion (x, y, z, w)
+    void setLocalTransform(Node node, const vmath::vec3& translation, const vmath::vec4& rotation, const vmath::vec3& scale);
+
+    // Recomputes world matrices of dirty subtrees; returns the number of nodes updated
+    int update();
+
+    // True if the node's world matrix changed in the last update()
+    bool wasUpdated(Node node) const { return updated[node] != 0; }
+
+    const vmath::mat4& getWorldMatrix(Node node) const { return worldMatrices[node]; }
+    int getNodeCount() const { return (int)parents.size(); }
+
+private:
+    vmath::mat4 getLocalMatrix(Node node) const;
+
+    std::vector<Node> parents;
+    std::vector<vmath::vec3> translations;
+    std::vector<vmath::vec4> rotations;
+    std::vector<vmath::vec3> scales;
+    std::vector<vmath::mat4> worldMatrices;
+    std::vector<unsigned char> dirty;
+    std::vector<unsigned char> updated;
+    Node firstDirty; // Nodes before this one are clean, so update() can start here
+};
@@ -0,0 +1,21 @@
+#pragma once
+#include "ModelData.h"
+
+// CPU block compression, run once at import time so the MeshCache stores GPU-ready mips.
+// Diffuse maps become BC1 (opaque) or BC7 (with alpha), normal maps BC5 holding only X and Y;
+// the shaders rebuild Z from the unit length.
+namespace TextureCompression {
+    bool isBlockFormat(TextureFormat format);
+
+    // Bytes per 4x4 block, 0 for uncompressed formats
+    size_t getBlockBytes(TextureFormat format);
+
+    // Size of one mip level in the given format
+    size_t getLevelBytes(TextureFormat format, int width, int height);
+
+    // True if every texel of an RGBA8 level 0 has full alpha
+    bool isOpaque(const TextureData& texture);
+
+    // Encodes every mip of an RGB8/RGBA8 texture in place. Thread-safe.
+    void compress(TextureData& texture, TextureFormat format);
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "MaterialSystem.h"
+#include <vector>
+
+// Decides how many mips of each texture are on the GPU. Every frame the renderer reports the
+// on-screen size of the materials it draws; from that each texture gets a wanted first level
+// (roughly one texel per pixel). update() then keeps the textures within the VRAM budget:
+// over budget it drops the top mip of the least recently drawn textures, under budget it brings
+// mips back for recently drawn textures that are blurrier than wanted, as long as they fit.
+// Changes are limited per frame so re-uploads are spread out.
+class TextureResidency {
+public:
+    static const int kMaxChangesPerFrame = 2;
+    static const unsigned long long kRecentFrames = 30; // Frames a texture counts as on screen after its last draw
+
+    struct Stats {
+        size_t budgetBytes;
+        size_t residentBytes; // Mips on the GPU, counting pending changes at their new level
+        size_t fullBytes;     // Every texture at full resolution
+        int textureCount;
+        int reducedCount;     // Textures missing their top mips
+        int promotions;       // Level changes started by the last update
+        int evictions;
+    };
+
+    TextureResidency();
+
+    void startup(MaterialSystem* materialSystem, size_t budgetBytes);
+    void shutdown();
+
+    void setBudget(size_t budgetBytes) { budget = budgetBytes; }
+    size_t getBudget() const { return budget; }
+
+    void addTextures(const std::vector<int>& textureIds);
+    void removeTextures(const std::vector<int>& textureIds);
+
+    // The material was drawn covering about screenPixels pixels across
+    void requestMaterial(GLuint materialId, float screenPixels);
+
+    // Once per frame, after the requests
+    void update();
+
+    const Stats& getStats() const { return stats; }
+
+private:
+    struct Entry {
+        bool tracked;
+        int wantedLevel;
+        unsigned long long lastUsedFrame;
+    };
+
+    void request(int textureId, float screenPixels);
+
+    MaterialSystem* materialSystem;
+    std::vector<Entry> entries; // Indexed by texture ID
+    size_t budget;
+    unsigned long long frameIndex;
+    Stats stats;
+};
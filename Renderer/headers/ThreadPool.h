@@ -0,0 +1,38 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads pulling tasks from one FIFO queue. Tasks must not touch GL;
+// anything that needs the context is handed back to the thread that owns it.
+class ThreadPool {
+public:
+    ThreadPool();
+    ~ThreadPool();
+
+    // threadCount 0 uses one worker per hardware thread, minus the caller's
+    void startup(unsigned int threadCount);
+    void shutdown();
+
+    void submit(std::function<void()> task);
+
+    // Runs body(0..count-1) across the workers and the calling thread, returning when all are done
+    void parallelFor(size_t count, const std::function<void(size_t)>& body);
+
+    unsigned int getThreadCount() const { return (unsigned int)workers.size(); }
+
+private:
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+
+    void workerLoop();
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable taskAvailable;
+    bool stopping;
+};
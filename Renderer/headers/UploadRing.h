@@ -0,0 +1,131 @@
+#pragma once
+#include "SharedUtilities.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// EXT_texture_compression_s3tc isn't in the core profile header
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+
+// Streams buffer and texture data to the GPU through one persistent-mapped staging buffer
+// (GL_ARB_buffer_storage). Data is copied into the ring and handed to the driver with
+// glCopyBufferSubData / PBO glTexSubImage2D; ring space is recycled once the fence placed
+// after each flush has signaled, without ever waiting on it.
+//
+// Every queued upload returns a ticket. Uploads are submitted in order, so anything drawn
+// after isSubmitted(ticket) returns true sees the data. Without buffer storage the ring
+// falls back to uploading synchronously at queue time.
+//
+// Given a window to share with, the copies run on an upload thread that owns a hidden shared
+// context. flush() then only hands newly queued work over (behind a fence, so the thread sees
+// the destinations the render thread created) and collects the uploads whose completion fence
+// has signaled; the byte budget no longer applies.
+class UploadRing {
+public:
+    typedef unsigned long long Ticket;
+
+    UploadRing();
+
+    // shareWindow may be null to keep every upload on the calling thread
+    void startup(size_t capacity, GLFWwindow* shareWindow);
+    void shutdown();
+
+    // Destination storage must already exist (glBufferData / glTexStorage2D / glTexStorage3D).
+    // target is GL_TEXTURE_2D or GL_TEXTURE_2D_ARRAY; layer is ignored for GL_TEXTURE_2D.
+    // format is the pixel format, or the internal format for BC1/BC5/BC7 block data.
+    Ticket queueBuffer(GLuint buffer, GLintptr offset, const void* data, size_t size);
+    Ticket queueTexture(GLuint texture, GLenum target, GLint level, GLint layer, GLsizei width, GLsizei height, GLenum format, const void* data, size_t size);
+
+    // Stops the upload thread between batches and makes the calling context wait for everything
+    // it submitted, so a destination can be copied and retargeted. Must be paired with resume().
+    void pause();
+    void resume();
+
+    // Redirects queued buffer uploads after the destination has been reallocated and copied.
+    // With an upload thread this must happen between pause() and resume().
+    void retargetBuffer(GLuint oldBuffer, GLuint newBuffer);
+
+    // Copies up to byteBudget bytes of pending uploads; returns the number of bytes submitted.
+    // With an upload thread, returns the bytes that completed since the last call.
+    size_t flush(size_t byteBudget);
+
+    bool isSubmitted(Ticket ticket) const { return ticket <= submittedTicket; }
+    Ticket getSubmittedTicket() const { return submittedTicket; }
+    bool isIdle() const;
+    bool isPersistent() const { return mappedData != nullptr; }
+    bool isThreaded() const { return uploadContext != nullptr; }
+
+private:
+    enum UploadType { Upload_Buffer, Upload_Texture };
+
+    struct PendingUpload {
+        UploadType type;
+        GLuint target;
+        GLintptr offset;   // Buffer: destination offset
+        GLenum textureTarget;
+        GLint level;       // Texture: mip level
+        GLint layer;       // Texture: array layer
+        GLsizei width;
+        GLsizei height;
+        GLenum format;
+        bool compressed;   // Texture: rows are rows of 4x4 blocks
+        size_t rowBytes;
+        size_t consumed;   // Bytes already submitted
+        std::vector<unsigned char> data;
+        Ticket ticket;
+    };
+
+    struct InFlightRegion {
+        GLsync fence;
+        size_t size; // Bytes of ring space released when the fence signals
+    };
+
+    // Fence from one context handing work to the other; ticket is the last upload it covers
+    struct HandOff {
+        GLsync fence;
+        Ticket ticket;
+        size_t bytes;
+    };
+
+    Ticket enqueue(PendingUpload& upload);
+    void retireRegions();
+    bool allocate(size_t size, size_t& offset);
+    size_t submitChunk(PendingUpload& upload, size_t byteBudget);
+
+    void releaseQueued();
+    size_t collectCompleted();
+    bool hasReleasedWork() const;
+    void uploadThreadLoop();
+    void submitBatch();
+
+    GLuint stagingBuffer;
+    unsigned char* mappedData;
+    size_t capacity;
+    size_t head;
+    size_t used;
+    size_t batchBytes; // Ring space consumed since the last fence
+
+    std::deque<PendingUpload> pending;
+    std::deque<InFlightRegion> inFlight;
+    Ticket queuedTicket;
+    Ticket submittedTicket;
+
+    // Upload thread; pending, releases, completed and the flags below are guarded by mutex.
+    // Ring space (head, used, inFlight) belongs to whichever thread does the copies.
+    GLFWwindow* uploadContext;
+    std::thread uploadThread;
+    mutable std::mutex mutex;
+    std::condition_variable workAvailable;
+    std::condition_variable workerIdle;
+    std::deque<HandOff> releases;  // Render thread -> upload thread
+    std::deque<HandOff> completed; // Upload thread -> render thread
+    Ticket releasedTicket;         // Last upload the render thread has handed over
+    Ticket workerTicket;           // Last upload the upload thread has fully submitted
+    bool stopping;
+    bool paused;
+    bool workerBusy;
+};
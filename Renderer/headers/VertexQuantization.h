@@ -0,0 +1,41 @@
+#pragma once
+#include "vmath.h"
+#include <vector>
+
+// Compact 20-byte vertices packed from MeshImport's 44-byte float layout after loading:
+//   position  4 x GL_UNSIGNED_SHORT normalized, 0..1 over a cube around the mesh AABB (w unused)
+//   normal    GL_INT_2_10_10_10_REV normalized, octahedral x/y
+//   tangent   GL_INT_2_10_10_10_REV normalized, octahedral x/y, w = bitangent sign
+//   uv        2 x GL_HALF_FLOAT
+// The cube is the same size on every axis so the position dequantization is a uniform scale and
+// offset; the shaders apply it before the model matrix and normals need no correction.
+namespace VertexQuantization {
+    enum VertexLayout {
+        VertexLayout_Float,  // MeshImport::kFloatsPerVertex floats
+        VertexLayout_Compact
+    };
+
+    const int kCompactStride = 20;
+    const int kPositionOffset = 0;
+    const int kNormalOffset = 8;
+    const int kTangentOffset = 12;
+    const int kTexCoordOffset = 16;
+
+    // Largest difference between a float vertex and its packed version
+    struct Error {
+        float position;       // In mesh units
+        float positionRelative; // position / largest AABB extent
+        float normalDegrees;
+        float tangentDegrees;
+        float texCoord;
+    };
+
+    // Packs interleaved float vertices. positionDequant maps the packed 0..1 positions back to
+    // mesh space: position * w + xyz. Bitangent signs come from the UV winding of the triangles
+    // around each vertex. Thread-safe.
+    Error quantize(const std::vector<float>& vertices, const std::vector<unsigned int>& indices,
+        std::vector<unsigned char>& packed, vmath::vec4& positionDequant);
+
+    unsigned short floatToHalf(float value);
+    float halfToFloat(unsigned short value);
+}
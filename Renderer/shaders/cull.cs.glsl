@@ -0,0 +1,159 @@
+#version 450 core
+
+// One workgroup per draw record; each thread tests every 64th instance of the record
+layout(local_size_x = 64) in;
+
+#define MAX_LODS 5 // kMaxLods in ModelData.h
+
+struct DrawRecord {
+    mat4 modelMatrix;
+    vec4 sphere; // Mesh-space bounding sphere: center, radius
+    vec4 positionDequant;
+    int baseVertex;
+    uint materialIndex;
+    uint firstInstance; // Range in InstanceBuffer
+    uint instanceCount;
+    uint outputOffset;  // Range in VisibleInstanceBuffer
+    uint wideIndices;   // 1 for 32-bit indices, drawn by the second multi-draw
+    uint lodCount;
+    uint lod;           // Level drawn last frame
+    uint lodFirstIndex[MAX_LODS];
+    uint lodIndexCount[MAX_LODS];
+    float lodError[MAX_LODS];
+    uint padding;
+};
+
+// Layout fixed by glMultiDrawElementsIndirectCountARB
+struct DrawCommand {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+layout(std430, binding = 2) readonly buffer InstanceBuffer {
+    mat4 instances[];
+};
+
+// Written back only to keep each record's LOD for the next frame
+layout(std430, binding = 3) buffer DrawRecordBuffer {
+    DrawRecord records[];
+};
+
+layout(std430, binding = 4) writeonly buffer DrawCommandBuffer {
+    DrawCommand commands[];
+};
+
+layout(std430, binding = 5) writeonly buffer CommandRecordBuffer {
+    uint commandRecords[]; // Record drawn by each command
+};
+
+layout(std430, binding = 6) writeonly buffer VisibleInstanceBuffer {
+    uint visibleInstances[];
+};
+
+layout(std430, binding = 7) buffer DrawCountBuffer {
+    uint drawCounts[2]; // 16-bit, 32-bit
+};
+
+// Read back by the CPU a few frames later
+layout(std430, binding = 8) buffer FeedbackBuffer {
+    uint feedbackDrawCount;
+    uint feedbackVisibleInstances;
+    uint feedbackTriangles;
+    uint feedbackCulledRecords;
+    uint materialSizes[]; // Largest on-screen size per material, as float bits
+};
+
+uniform mat4 viewMatrix;
+uniform mat4 animationMatrix; // Applied in model space to every draw
+uniform vec4 frustumPlanes[6]; // ax + by + cz + d >= 0 is inside
+uniform float projScale;       // projMatrix[1][1] * viewport height
+uniform float screenHeight;
+uniform uint wideCommandStart; // First command slot of the 32-bit records
+uniform float maxPixelError;   // LevelOfDetail::kMaxPixelError
+uniform float lodHysteresis;   // LevelOfDetail::kHysteresis
+
+shared uint visibleCount;
+shared uint largestSize;
+shared uint largestPixelsPerUnit;
+
+void main(void)
+{
+    uint recordIndex = gl_WorkGroupID.x;
+    DrawRecord record = records[recordIndex];
+
+    if (gl_LocalInvocationIndex == 0) {
+        visibleCount = 0;
+        largestSize = 0;
+        largestPixelsPerUnit = 0;
+    }
+    memoryBarrierShared();
+    barrier();
+
+    mat4 meshMatrix = record.modelMatrix * animationMatrix;
+    for (uint i = gl_LocalInvocationIndex; i < record.instanceCount; i += gl_WorkGroupSize.x) {
+        mat4 modelMatrix = instances[record.firstInstance + i] * meshMatrix;
+
+        // Sphere: transformed center, radius scaled by the largest axis scale
+        vec3 center = vec3(modelMatrix * vec4(record.sphere.xyz, 1.0));
+        float maxScaleSquared = max(max(dot(modelMatrix[0].xyz, modelMatrix[0].xyz), dot(modelMatrix[1].xyz, modelMatrix[1].xyz)),
+            dot(modelMatrix[2].xyz, modelMatrix[2].xyz));
+        float radius = record.sphere.w * sqrt(maxScaleSquared);
+
+        bool visible = true;
+        for (int plane = 0; plane < 6; plane++) {
+            visible = visible && dot(frustumPlanes[plane].xyz, center) + frustumPlanes[plane].w >= -radius;
+        }
+
+        if (visible) {
+            uint slot = atomicAdd(visibleCount, 1);
+            visibleInstances[record.outputOffset + slot] = record.firstInstance + i;
+
+            // Same estimate as Renderer::getProjectedSize
+            float distance = -(viewMatrix * vec4(center, 1.0)).z;
+            float size = distance <= radius ? screenHeight : radius * projScale / distance;
+            atomicMax(largestSize, floatBitsToUint(size));
+
+            // Same estimate as Renderer::getPixelsPerUnit: one mesh unit at the sphere's nearest point
+            float nearest = distance - radius;
+            float pixelsPerUnit = nearest <= 0.0 ? 3.4e38 : sqrt(maxScaleSquared) * projScale * 0.5 / nearest;
+            atomicMax(largestPixelsPerUnit, floatBitsToUint(pixelsPerUnit));
+        }
+    }
+
+    memoryBarrierShared();
+    barrier();
+
+    if (gl_LocalInvocationIndex != 0) {
+        return;
+    }
+
+    if (visibleCount == 0) {
+        atomicAdd(feedbackCulledRecords, 1);
+        return;
+    }
+
+    // Same rule as LevelOfDetail::selectLod: finer as soon as the error shows, coarser only well under the limit
+    float pixelsPerUnit = uintBitsToFloat(largestPixelsPerUnit);
+    uint lod = min(record.lod, record.lodCount - 1);
+    while (lod > 0 && record.lodError[lod] * pixelsPerUnit > maxPixelError) {
+        lod--;
+    }
+    while (lod + 1 < record.lodCount && record.lodError[lod + 1] * pixelsPerUnit <= maxPixelError * lodHysteresis) {
+        lod++;
+    }
+    records[recordIndex].lod = lod;
+    uint indexCount = record.lodIndexCount[lod];
+
+    // Commands are appended in whatever order the workgroups finish, each index type in its own range
+    uint command = atomicAdd(drawCounts[record.wideIndices], 1) + (record.wideIndices != 0 ? wideCommandStart : 0);
+    commands[command] = DrawCommand(indexCount, visibleCount, record.lodFirstIndex[lod], record.baseVertex, record.outputOffset);
+    commandRecords[command] = recordIndex;
+
+    atomicAdd(feedbackDrawCount, 1);
+    atomicAdd(feedbackVisibleInstances, visibleCount);
+    atomicAdd(feedbackTriangles, indexCount / 3 * visibleCount);
+    atomicMax(materialSizes[record.materialIndex], largestSize);
+}
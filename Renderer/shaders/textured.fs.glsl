@@ -3,12 +3,36 @@
 in vec2 TexCoords;
 in vec3 FragPos;
 in mat3 TBN;  
+flat in uint MaterialIndex;
 
 out vec4 color;
 
-uniform sampler2D diffuseSampler;
-uniform sampler2D normalSampler;
-uniform bool isValidMaterial;
+// Texture array slot and layer per map, slot -1 when the material doesn't use it
+struct Material {
+    int diffuseArray;
+    int diffuseLayer;
+    int normalArray;
+    int normalLayer;
+};
+
+layout(std430, binding = 1) readonly buffer MaterialBuffer {
+    Material materials[];
+};
+
+uniform sampler2DArray textureArrays[16];
+
+// Sampler array indices must be dynamically uniform, and a wave can hold fragments of several
+// multi-draw sub-draws, so the slot is picked by looping over constant indices. Gradients come
+// from outside the branch.
+vec4 sampleArray(int slot, vec3 coords, vec2 dx, vec2 dy) {
+    vec4 result = vec4(0.0);
+    for (int i = 0; i < 16; i++) {
+        if (i == slot) {
+            result = textureGrad(textureArrays[i], coords, dx, dy);
+        }
+    }
+    return result;
+}
 
 uniform vec3 lightDir;
 uniform vec3 lightColor;
@@ -16,15 +40,25 @@ uniform vec3 viewPos;
 
 void main(void)
 {
-    if (!isValidMaterial) {            
+    Material material = materials[MaterialIndex];
+    vec2 texCoordsDx = dFdx(TexCoords);
+    vec2 texCoordsDy = dFdy(TexCoords);
+
+    if (material.diffuseArray < 0) {            
         color = vec4(0.0f, 0.0f, 0.0f, 1.0f);
         return;
     } 
     
-    vec3 normal = texture(normalSampler, TexCoords).rgb;
-    normal = normalize(TBN * (normal * 2.0 - 1.0));
+    // Fall back to the vertex normal when the material has no normal map
+    vec3 normal = vec3(0.0, 0.0, 1.0);
+    if (material.normalArray >= 0) {
+        // Normal maps are two-channel (BC5), so Z is rebuilt from the unit length
+        vec2 normalXY = sampleArray(material.normalArray, vec3(TexCoords, material.normalLayer), texCoordsDx, texCoordsDy).rg * 2.0 - 1.0;
+        normal = vec3(normalXY, sqrt(max(1.0 - dot(normalXY, normalXY), 0.0)));
+    }
+    normal = normalize(TBN * normal);
 
-    vec3 diffuseColor = texture(diffuseSampler, TexCoords).rgb;
+    vec3 diffuseColor = sampleArray(material.diffuseArray, vec3(TexCoords, material.diffuseLayer), texCoordsDx, texCoordsDy).rgb;
 
     // Simple directional lighting
     vec3 lightDirNorm = normalize(-lightDir);
@@ -1,30 +1,56 @@
 #version 450 core
 
 layout(location = 0) in vec3 position;
-layout(location = 1) in vec3 normal;
-layout(location = 2) in vec3 tangent;
+layout(location = 1) in vec4 normal;  // Float vertices: xyz. Compact: octahedral xy.
+layout(location = 2) in vec4 tangent; // w: bitangent sign (1 for float vertices)
 layout(location = 3) in vec2 texCoords;
 
 out vec2 TexCoords;
 out vec3 FragPos;
 out mat3 TBN; // Tangent-Bitangent-Normal matrix
+flat out uint MaterialIndex;
+
+layout(std430, binding = 2) readonly buffer InstanceBuffer {
+    mat4 instances[];
+};
 
 uniform mat4 modelMatrix;
+uniform uint materialIndex;
+uniform uint firstInstance; // The mesh's range in InstanceBuffer
+uniform vec4 positionDequant; // Vertex position to mesh space: p * w + xyz
+uniform bool octahedralNormals;
 uniform mat4 viewMatrix;
 uniform mat4 projMatrix;
 
+// Compact vertices store unit vectors octahedrally in x/y (see VertexQuantization)
+vec3 decodeOctahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0) {
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(n);
+}
+
 void main(void)
 {
+    mat4 model = instances[firstInstance + gl_InstanceID] * modelMatrix;
+
     TexCoords = texCoords;
+    MaterialIndex = materialIndex;
+
+    vec4 meshPosition = vec4(position * positionDequant.w + positionDequant.xyz, 1.0);
 
     // Fragment position in world space
-    FragPos = vec3(modelMatrix * vec4(position, 1.0));
+    FragPos = vec3(model * meshPosition);
         
-    vec3 T = normalize(vec3(modelMatrix * vec4(tangent, 0.0)));
-    vec3 N = normalize(vec3(modelMatrix * vec4(normal, 0.0)));
-    vec3 B = cross(N, T);
+    vec3 meshNormal = octahedralNormals ? decodeOctahedral(normal.xy) : normal.xyz;
+    vec3 meshTangent = octahedralNormals ? decodeOctahedral(tangent.xy) : tangent.xyz;
+    vec3 T = normalize(vec3(model * vec4(meshTangent, 0.0)));
+    vec3 N = normalize(vec3(model * vec4(meshNormal, 0.0)));
+    vec3 B = cross(N, T) * tangent.w;
 
     TBN = mat3(T, B, N);
 
-    gl_Position = projMatrix * viewMatrix * modelMatrix * vec4(position, 1.0);
+    gl_Position = projMatrix * viewMatrix * model * meshPosition;
 }
\ No newline at end of file
@@ -0,0 +1,59 @@
+#version 450 core
+#extension GL_ARB_bindless_texture : require
+// Handles come from the material table per draw, so they aren't dynamically uniform across a
+// wave of a multi-draw; NV_gpu_shader5 allows that. Without it the array shader is used instead.
+#extension GL_NV_gpu_shader5 : require
+
+in vec2 TexCoords;
+in vec3 FragPos;
+in mat3 TBN;  
+flat in uint MaterialIndex;
+
+out vec4 color;
+
+// Resident texture handles per map, zero when the material doesn't use it
+struct Material {
+    uvec2 diffuseHandle;
+    uvec2 normalHandle;
+};
+
+layout(std430, binding = 1) readonly buffer MaterialBuffer {
+    Material materials[];
+};
+
+uniform vec3 lightDir;
+uniform vec3 lightColor;
+uniform vec3 viewPos;
+
+void main(void)
+{
+    Material material = materials[MaterialIndex];
+
+    if (!any(notEqual(material.diffuseHandle, uvec2(0)))) {            
+        color = vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        return;
+    } 
+    
+    // Fall back to the vertex normal when the material has no normal map
+    vec3 normal = vec3(0.0, 0.0, 1.0);
+    if (any(notEqual(material.normalHandle, uvec2(0)))) {
+        // Normal maps are two-channel (BC5), so Z is rebuilt from the unit length
+        vec2 normalXY = texture(sampler2D(material.normalHandle), TexCoords).rg * 2.0 - 1.0;
+        normal = vec3(normalXY, sqrt(max(1.0 - dot(normalXY, normalXY), 0.0)));
+    }
+    normal = normalize(TBN * normal);
+
+    vec3 diffuseColor = texture(sampler2D(material.diffuseHandle), TexCoords).rgb;
+
+    // Simple directional lighting
+    vec3 lightDirNorm = normalize(-lightDir);
+    float diff = max(dot(normal, lightDirNorm), 0.0);
+    vec3 diffuse = diff * lightColor;
+
+    // Ambient lighting
+    vec3 ambient = 0.1 * lightColor;
+
+    // Combine results
+    vec3 result = (ambient + diffuse) * diffuseColor;
+    color = vec4(result, 1.0);
+}
\ No newline at end of file
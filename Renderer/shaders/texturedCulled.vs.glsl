@@ -0,0 +1,91 @@
+#version 450 core
+#extension GL_ARB_shader_draw_parameters : require
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec4 normal;  // Float vertices: xyz. Compact: octahedral xy.
+layout(location = 2) in vec4 tangent; // w: bitangent sign (1 for float vertices)
+layout(location = 3) in vec2 texCoords;
+
+out vec2 TexCoords;
+out vec3 FragPos;
+out mat3 TBN; // Tangent-Bitangent-Normal matrix
+flat out uint MaterialIndex;
+
+#define MAX_LODS 5 // kMaxLods in ModelData.h
+
+// Written by cull.cs.glsl; see GpuCulling
+struct DrawRecord {
+    mat4 modelMatrix;
+    vec4 sphere;
+    vec4 positionDequant; // Vertex position to mesh space: p * w + xyz
+    int baseVertex;
+    uint materialIndex;
+    uint firstInstance;
+    uint instanceCount;
+    uint outputOffset;
+    uint wideIndices;
+    uint lodCount;
+    uint lod;
+    uint lodFirstIndex[MAX_LODS];
+    uint lodIndexCount[MAX_LODS];
+    float lodError[MAX_LODS];
+    uint padding;
+};
+
+layout(std430, binding = 2) readonly buffer InstanceBuffer {
+    mat4 instances[];
+};
+
+layout(std430, binding = 3) readonly buffer DrawRecordBuffer {
+    DrawRecord records[];
+};
+
+layout(std430, binding = 5) readonly buffer CommandRecordBuffer {
+    uint commandRecords[];
+};
+
+// The command's baseInstance is where its visible instances start
+layout(std430, binding = 6) readonly buffer VisibleInstanceBuffer {
+    uint visibleInstances[];
+};
+
+uniform mat4 viewMatrix;
+uniform mat4 projMatrix;
+uniform mat4 animationMatrix; // Applied in model space to every draw
+uniform uint drawOffset; // First command of this multi-draw; there is one per index type
+uniform bool octahedralNormals;
+
+// Compact vertices store unit vectors octahedrally in x/y (see VertexQuantization)
+vec3 decodeOctahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0) {
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(n);
+}
+
+void main(void)
+{
+    DrawRecord record = records[commandRecords[drawOffset + gl_DrawIDARB]];
+    uint instance = visibleInstances[gl_BaseInstanceARB + gl_InstanceID];
+    mat4 modelMatrix = instances[instance] * record.modelMatrix * animationMatrix;
+
+    TexCoords = texCoords;
+    MaterialIndex = record.materialIndex;
+
+    vec4 meshPosition = vec4(position * record.positionDequant.w + record.positionDequant.xyz, 1.0);
+
+    // Fragment position in world space
+    FragPos = vec3(modelMatrix * meshPosition);
+        
+    vec3 meshNormal = octahedralNormals ? decodeOctahedral(normal.xy) : normal.xyz;
+    vec3 meshTangent = octahedralNormals ? decodeOctahedral(tangent.xy) : tangent.xyz;
+    vec3 T = normalize(vec3(modelMatrix * vec4(meshTangent, 0.0)));
+    vec3 N = normalize(vec3(modelMatrix * vec4(meshNormal, 0.0)));
+    vec3 B = cross(N, T) * tangent.w;
+
+    TBN = mat3(T, B, N);
+
+    gl_Position = projMatrix * viewMatrix * modelMatrix * meshPosition;
+}
@@ -0,0 +1,68 @@
+#version 450 core
+#extension GL_ARB_shader_draw_parameters : require
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec4 normal;  // Float vertices: xyz. Compact: octahedral xy.
+layout(location = 2) in vec4 tangent; // w: bitangent sign (1 for float vertices)
+layout(location = 3) in vec2 texCoords;
+
+out vec2 TexCoords;
+out vec3 FragPos;
+out mat3 TBN; // Tangent-Bitangent-Normal matrix
+flat out uint MaterialIndex;
+
+// Per-draw data, indexed by the draw's position in the multi-draw
+struct DrawData {
+    mat4 modelMatrix;
+    vec4 positionDequant; // Vertex position to mesh space: p * w + xyz
+    uint materialIndex; // Entry in the material table
+    uint firstInstance; // Range in InstanceBuffer
+};
+
+layout(std430, binding = 0) readonly buffer DrawDataBuffer {
+    DrawData draws[];
+};
+
+layout(std430, binding = 2) readonly buffer InstanceBuffer {
+    mat4 instances[];
+};
+
+uniform mat4 viewMatrix;
+uniform mat4 projMatrix;
+uniform mat4 animationMatrix; // Applied in model space to every draw
+uniform uint drawOffset; // First command of this multi-draw; there is one per index type
+uniform bool octahedralNormals;
+
+// Compact vertices store unit vectors octahedrally in x/y (see VertexQuantization)
+vec3 decodeOctahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0) {
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(n);
+}
+
+void main(void)
+{
+    DrawData draw = draws[drawOffset + gl_DrawIDARB];
+    mat4 modelMatrix = instances[draw.firstInstance + gl_InstanceID] * draw.modelMatrix * animationMatrix;
+
+    TexCoords = texCoords;
+    MaterialIndex = draw.materialIndex;
+
+    vec4 meshPosition = vec4(position * draw.positionDequant.w + draw.positionDequant.xyz, 1.0);
+
+    // Fragment position in world space
+    FragPos = vec3(modelMatrix * meshPosition);
+        
+    vec3 meshNormal = octahedralNormals ? decodeOctahedral(normal.xy) : normal.xyz;
+    vec3 meshTangent = octahedralNormals ? decodeOctahedral(tangent.xy) : tangent.xyz;
+    vec3 T = normalize(vec3(modelMatrix * vec4(meshTangent, 0.0)));
+    vec3 N = normalize(vec3(modelMatrix * vec4(meshNormal, 0.0)));
+    vec3 B = cross(N, T) * tangent.w;
+
+    TBN = mat3(T, B, N);
+
+    gl_Position = projMatrix * viewMatrix * modelMatrix * meshPosition;
+}
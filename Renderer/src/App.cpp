@@ -1,11 +1,64 @@
-
 #include "../headers/Renderer.h"
+#include "../headers/Benchmark.h"
+#include <string.h>
+#include <stdlib.h>
+
+static const char* const kDefaultModelPath = "../Assets/Models/haloSpartan2.glb";
+static const int kDefaultHeadlessFrames = 300;
+static const double kHeadlessTimeStep = 1.0 / 60.0;
+static const int kBudgetCycles = 4;
+
+// Returns the token following option in the command line ("--frames 500" -> "500"), or an empty string
+static std::string getOptionValue(const char* commandLine, const char* option) {
+    const char* found = strstr(commandLine, option);
+    if (!found) {
+        return std::string();
+    }
+
+    const char* value = found + strlen(option);
+    while (*value == ' ') {
+        value++;
+    }
+
+    const char* end = value;
+    while (*end && *end != ' ') {
+        end++;
+    }
+    return std::string(value, end);
+}
 
 int CALLBACK WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow)
 {
+    const char* commandLine = lpCmdLine ? lpCmdLine : "";
+
+    // CPU-only import benchmark, no window needed
+    if (strstr(commandLine, "--bench-import")) {
+        Benchmark::runImportBenchmark("../Assets/Models");
+        return 0;
+    }
+
+    if (strstr(commandLine, "--bench-vmath")) {
+        Benchmark::runVmathBenchmark();
+        return 0;
+    }
+
+    // --headless renders offscreen with a hidden window: --headless [--frames N] [--model path]
+    // [--cycle-budget path]. --cycle-budget afterwards cycles the texture budget and loads path.
+    bool headless = strstr(commandLine, "--headless") != NULL;
+
+    std::string modelPath = getOptionValue(commandLine, "--model");
+    if (modelPath.empty()) {
+        modelPath = kDefaultModelPath;
+    }
+
     int windowWidth = 800;
     int windowHeight = 600;
 
+    // Hints set after glfwInit survive CreateAppWindow's own glfwInit call
+    if (headless && glfwInit()) {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    }
+
     GLFWwindow* window = ES::CreateAppWindow(windowWidth, windowHeight, "Renderer");
 
     if (window == NULL)
@@ -14,13 +67,39 @@ int CALLBACK WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLi
         return 0;
     }
 
+    // --vertex-format float keeps the 44-byte float vertices instead of the 20-byte packed ones.
+    // --short-indices splits large meshes so every mesh uses 16-bit indices.
+    GeometrySettings geometrySettings;
+    geometrySettings.vertexLayout = VertexQuantization::VertexLayout_Compact;
+    if (getOptionValue(commandLine, "--vertex-format") == "float") {
+        geometrySettings.vertexLayout = VertexQuantization::VertexLayout_Float;
+    }
+    geometrySettings.shortIndicesOnly = strstr(commandLine, "--short-indices") != NULL;
+
     Renderer renderer;
-    renderer.startup(windowWidth, windowHeight);
-    renderer.runGameLoop(window);
+    renderer.startup(windowWidth, windowHeight, modelPath, geometrySettings);
+
+    // --texture-budget MB caps the VRAM used by texture mips
+    std::string textureBudget = getOptionValue(commandLine, "--texture-budget");
+    if (!textureBudget.empty()) {
+        renderer.setTextureBudget((size_t)atoi(textureBudget.c_str()) * 1024 * 1024);
+    }
+    if (headless) {
+        std::string frames = getOptionValue(commandLine, "--frames");
+        renderer.runHeadless(frames.empty() ? kDefaultHeadlessFrames : atoi(frames.c_str()), kHeadlessTimeStep);
+
+        std::string cycleModelPath = getOptionValue(commandLine, "--cycle-budget");
+        if (!cycleModelPath.empty()) {
+            renderer.runBudgetCycle(cycleModelPath, kBudgetCycles);
+        }
+    }
+    else {
+        renderer.runGameLoop(window);
+    }
     renderer.shutdown();
 
     glfwDestroyWindow(window);
     glfwTerminate();
 
     return 0;
-}
\ No newline at end of file
+}
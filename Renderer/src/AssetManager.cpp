@@ -0,0 +1,98 @@
+#include "../headers/AssetManager.h"
+#include "SharedUtilities.h"
+
+AssetManager::AssetManager() : threadPool(nullptr), nextHandle(1), loadsInFlight(0) {
+}
+
+void AssetManager::startup(ThreadPool* pool, Loader modelLoader) {
+    threadPool = pool;
+    loader = modelLoader;
+}
+
+void AssetManager::shutdown() {
+    std::unique_lock<std::mutex> lock(mutex);
+    loadFinished.wait(lock, [this] { return loadsInFlight == 0; });
+
+    requests.clear();
+    loaded.clear();
+}
+
+AssetManager::Handle AssetManager::requestModel(const std::string& path) {
+    Handle handle;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        handle = nextHandle++;
+        Request request;
+        request.path = path;
+        request.state = State_Loading;
+        requests[handle] = request;
+        loadsInFlight++;
+    }
+
+    threadPool->submit([this, handle, path] { load(handle, path); });
+    return handle;
+}
+
+void AssetManager::load(Handle handle, std::string path) {
+    ModelData modelData;
+    bool ok = loader(path, modelData);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::map<Handle, Request>::iterator request = requests.find(handle);
+    if (request != requests.end()) {
+        if (ok) {
+            request->second.state = State_Loaded;
+            loaded.push_back(std::make_pair(handle, std::move(modelData)));
+        }
+        else {
+            request->second.state = State_Failed;
+            OutputDebugStringA(("\nFailed to load model " + path).c_str());
+        }
+    }
+
+    loadsInFlight--;
+    loadFinished.notify_all();
+}
+
+AssetManager::State AssetManager::getState(Handle handle) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::map<Handle, Request>::const_iterator request = requests.find(handle);
+    return request != requests.end() ? request->second.state : State_Unknown;
+}
+
+bool AssetManager::isBusy() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return loadsInFlight > 0 || !loaded.empty();
+}
+
+bool AssetManager::takeLoaded(Handle& handle, ModelData& modelData) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (loaded.empty()) {
+        return false;
+    }
+
+    handle = loaded.front().first;
+    modelData = std::move(loaded.front().second);
+    loaded.pop_front();
+    return true;
+}
+
+void AssetManager::markResident(Handle handle) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::map<Handle, Request>::iterator request = requests.find(handle);
+    if (request != requests.end()) {
+        request->second.state = State_Resident;
+    }
+}
+
+void AssetManager::release(Handle handle) {
+    std::lock_guard<std::mutex> lock(mutex);
+    requests.erase(handle);
+
+    for (std::deque<std::pair<Handle, ModelData>>::iterator it = loaded.begin(); it != loaded.end(); ++it) {
+        if (it->first == handle) {
+            loaded.erase(it);
+            break;
+        }
+    }
+}
@@ -0,0 +1,241 @@
+#include "../headers/Benchmark.h"
+#include "../headers/MeshImport.h"
+#include "SharedUtilities.h"
+#include "vmath.h"
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include <chrono>
+#include <vector>
+#include <stdlib.h>
+
+namespace Benchmark {
+    static const int kIterations = 10;
+
+    static void report(const char* text) {
+        OutputDebugStringA(text);
+        fputs(text, stdout);
+    }
+
+    static std::vector<std::string> findModels(const std::string& modelDirectory) {
+        std::vector<std::string> paths;
+        WIN32_FIND_DATAA findData;
+        HANDLE handle = FindFirstFileA((modelDirectory + "/*.glb").c_str(), &findData);
+        if (handle == INVALID_HANDLE_VALUE) {
+            return paths;
+        }
+
+        do {
+            if (!(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+                paths.push_back(modelDirectory + "/" + findData.cFileName);
+            }
+        } while (FindNextFileA(handle, &findData));
+
+        FindClose(handle);
+        return paths;
+    }
+
+    // Best of kIterations, in milliseconds, filling every mesh of the scene into a fresh vector
+    template <typename FillFunction>
+    static double timeFill(const aiScene* scene, FillFunction fill) {
+        double best = 0.0;
+        for (int iteration = 0; iteration < kIterations; iteration++) {
+            auto start = std::chrono::high_resolution_clock::now();
+            for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+                std::vector<float> vertices;
+                fill(scene->mMeshes[i], vertices);
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+
+            double elapsed = std::chrono::duration<double, std::milli>(end - start).count();
+            if (iteration == 0 || elapsed < best) {
+                best = elapsed;
+            }
+        }
+        return best;
+    }
+
+    void runImportBenchmark(const std::string& modelDirectory) {
+        char line[512];
+        std::vector<std::string> paths = findModels(modelDirectory);
+        if (paths.empty()) {
+            report("\nNo .glb models found for import benchmark");
+            return;
+        }
+
+        report("\nmodel, vertices, readFile ms, reference ms/Mvert, fast ms/Mvert, speedup\n");
+
+        for (const std::string& path : paths) {
+            Assimp::Importer importer;
+
+            auto start = std::chrono::high_resolution_clock::now();
+            const aiScene* scene = importer.ReadFile(path, MeshImport::kImportFlags);
+            auto end = std::chrono::high_resolution_clock::now();
+            double readFileMs = std::chrono::duration<double, std::milli>(end - start).count();
+
+            if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+                snprintf(line, sizeof(line), "%s, failed to load\n", path.c_str());
+                report(line);
+                continue;
+            }
+
+            size_t vertexCount = 0;
+            for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+                vertexCount += scene->mMeshes[i]->mNumVertices;
+            }
+            if (vertexCount == 0) {
+                continue;
+            }
+
+            double referenceMs = timeFill(scene, MeshImport::fillVerticesReference);
+            double fastMs = timeFill(scene, MeshImport::fillVertices);
+            double millions = vertexCount / 1000000.0;
+
+            snprintf(line, sizeof(line), "%s, %zu, %.2f, %.3f, %.3f, %.2fx\n",
+                path.c_str(), vertexCount, readFileMs,
+                referenceMs / millions, fastMs / millions,
+                fastMs > 0.0 ? referenceMs / fastMs : 0.0);
+            report(line);
+        }
+    }
+
+    static const size_t kVmathCount = 4096;
+    static const float kVmathTolerance = 1e-4f;
+
+    // Scalar references: the generic vmath loops, unaffected by VMATH_SIMD
+    static vmath::mat4 referenceMultiply(const vmath::mat4& a, const vmath::mat4& b) {
+        vmath::mat4 result;
+        for (int j = 0; j < 4; j++) {
+            for (int i = 0; i < 4; i++) {
+                float sum = 0.0f;
+                for (int n = 0; n < 4; n++) {
+                    sum += a[n][i] * b[j][n];
+                }
+                result[j][i] = sum;
+            }
+        }
+        return result;
+    }
+
+    static vmath::mat4 referenceTranspose(const vmath::mat4& a) {
+        vmath::mat4 result;
+        for (int j = 0; j < 4; j++) {
+            for (int i = 0; i < 4; i++) {
+                result[i][j] = a[j][i];
+            }
+        }
+        return result;
+    }
+
+    static vmath::vec4 referenceTransform(const vmath::mat4& a, const vmath::vec4& v) {
+        vmath::vec4 result(0.0f);
+        for (int m = 0; m < 4; m++) {
+            for (int n = 0; n < 4; n++) {
+                result[n] += a[m][n] * v[m];
+            }
+        }
+        return result;
+    }
+
+    static vmath::mat4 referenceInverse(const vmath::mat4& a) {
+        return vmath::inverse<float>(a);
+    }
+
+    // Well-conditioned affine transforms, like the ones the renderer actually inverts
+    static std::vector<vmath::mat4> makeTestMatrices() {
+        srand(1);
+        std::vector<vmath::mat4> matrices(kVmathCount);
+        for (vmath::mat4& matrix : matrices) {
+            float angle = rand() % 360;
+            float s = 0.5f + (rand() % 100) / 50.0f;
+            matrix = vmath::translate((float)(rand() % 20 - 10), (float)(rand() % 20 - 10), (float)(rand() % 20 - 10))
+                * vmath::rotate(angle, 0.3f, 0.5f, 0.8f) * vmath::scale(s, s * 0.5f, s * 2.0f);
+        }
+        return matrices;
+    }
+
+    static float getMaxError(const vmath::mat4& a, const vmath::mat4& b) {
+        float error = 0.0f;
+        for (int i = 0; i < 4; i++) {
+            for (int j = 0; j < 4; j++) {
+                float difference = fabsf(a[i][j] - b[i][j]) / (fabsf(b[i][j]) > 1.0f ? fabsf(b[i][j]) : 1.0f);
+                error = difference > error ? difference : error;
+            }
+        }
+        return error;
+    }
+
+    // Best of kIterations, in nanoseconds per operation; op(i) returns a matrix for the checksum sink
+    template <typename Operation>
+    static double timeOperation(Operation op, float& sink) {
+        double best = 0.0;
+        for (int iteration = 0; iteration < kIterations; iteration++) {
+            auto start = std::chrono::high_resolution_clock::now();
+            for (size_t i = 0; i < kVmathCount; i++) {
+                sink += op(i)[0][0];
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+
+            double elapsed = std::chrono::duration<double, std::nano>(end - start).count() / kVmathCount;
+            if (iteration == 0 || elapsed < best) {
+                best = elapsed;
+            }
+        }
+        return best;
+    }
+
+    template <typename ReferenceOperation, typename FastOperation>
+    static void reportOperation(const char* name, ReferenceOperation reference, FastOperation fast, float& sink) {
+        float error = 0.0f;
+        for (size_t i = 0; i < kVmathCount; i++) {
+            vmath::mat4 expected = reference(i);
+            vmath::mat4 actual = fast(i);
+            float difference = getMaxError(actual, expected);
+            error = difference > error ? difference : error;
+        }
+
+        double referenceNs = timeOperation(reference, sink);
+        double fastNs = timeOperation(fast, sink);
+
+        char line[256];
+        snprintf(line, sizeof(line), "%s, %.2f, %.2f, %.2fx, %g, %s\n", name, referenceNs, fastNs,
+            fastNs > 0.0 ? referenceNs / fastNs : 0.0, error, error <= kVmathTolerance ? "ok" : "FAILED");
+        report(line);
+    }
+
+    void runVmathBenchmark() {
+#ifdef VMATH_SSE
+        report("\nvmath: SSE\n");
+#else
+        report("\nvmath: scalar (build with VMATH_SIMD for the SSE path)\n");
+#endif
+        report("operation, reference ns, vmath ns, speedup, max relative error, result\n");
+
+        std::vector<vmath::mat4> a = makeTestMatrices();
+        std::vector<vmath::mat4> b(a.rbegin(), a.rend());
+        float sink = 0.0f;
+
+        reportOperation("mat4 * mat4",
+            [&](size_t i) { return referenceMultiply(a[i], b[i]); },
+            [&](size_t i) { return vmath::mat4(a[i] * b[i]); }, sink);
+
+        reportOperation("transpose",
+            [&](size_t i) { return referenceTranspose(a[i]); },
+            [&](size_t i) { return vmath::mat4(a[i].transpose()); }, sink);
+
+        reportOperation("inverse",
+            [&](size_t i) { return referenceInverse(a[i]); },
+            [&](size_t i) { return vmath::inverse(a[i]); }, sink);
+
+        // One transformed vector per column, so the result fits the matrix comparison
+        reportOperation("mat4 * vec4 (x4)",
+            [&](size_t i) { return vmath::mat4(referenceTransform(a[i], b[i][0]), referenceTransform(a[i], b[i][1]),
+                referenceTransform(a[i], b[i][2]), referenceTransform(a[i], b[i][3])); },
+            [&](size_t i) { return vmath::mat4(a[i] * b[i][0], a[i] * b[i][1], a[i] * b[i][2], a[i] * b[i][3]); }, sink);
+
+        // Keeps the timed loops from being optimized away
+        char line[64];
+        snprintf(line, sizeof(line), "checksum %g\n", sink);
+        report(line);
+    }
+}
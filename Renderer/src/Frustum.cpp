@@ -0,0 +1,132 @@
+#include "../headers/Frustum.h"
+
+void Frustum::extract(const vmath::mat4& viewProjection) {
+    // Row r of the clip matrix is (m[0][r], m[1][r], m[2][r], m[3][r])
+    float planes[8][4];
+    for (int axis = 0; axis < 3; axis++) {
+        for (int column = 0; column < 4; column++) {
+            planes[axis * 2][column] = viewProjection[column][3] + viewProjection[column][axis];
+            planes[axis * 2 + 1][column] = viewProjection[column][3] - viewProjection[column][axis];
+        }
+    }
+
+    // Normalized, so the plane distance can be compared against a sphere radius
+    for (int i = 0; i < 6; i++) {
+        float length = sqrtf(planes[i][0] * planes[i][0] + planes[i][1] * planes[i][1] + planes[i][2] * planes[i][2]);
+        float scale = length > 0.0f ? 1.0f / length : 0.0f;
+        for (int j = 0; j < 4; j++) {
+            planes[i][j] *= scale;
+        }
+    }
+
+    for (int j = 0; j < 4; j++) {
+        planes[6][j] = planes[5][j];
+        planes[7][j] = planes[5][j];
+    }
+
+    for (int group = 0; group < 2; group++) {
+        const float (*p)[4] = planes + group * 4;
+        planeX[group] = _mm_setr_ps(p[0][0], p[1][0], p[2][0], p[3][0]);
+        planeY[group] = _mm_setr_ps(p[0][1], p[1][1], p[2][1], p[3][1]);
+        planeZ[group] = _mm_setr_ps(p[0][2], p[1][2], p[2][2], p[3][2]);
+        planeD[group] = _mm_setr_ps(p[0][3], p[1][3], p[2][3], p[3][3]);
+    }
+}
+
+bool Frustum::isVisible(const BoundingVolume& bounds, const vmath::mat4& modelMatrix) const {
+    const vmath::mat4& m = modelMatrix;
+
+    // Sphere: transformed center, radius scaled by the largest axis scale
+    const vmath::vec3& sc = bounds.sphereCenter;
+    float sphereX = m[0][0] * sc[0] + m[1][0] * sc[1] + m[2][0] * sc[2] + m[3][0];
+    float sphereY = m[0][1] * sc[0] + m[1][1] * sc[1] + m[2][1] * sc[2] + m[3][1];
+    float sphereZ = m[0][2] * sc[0] + m[1][2] * sc[1] + m[2][2] * sc[2] + m[3][2];
+
+    float maxScaleSquared = 0.0f;
+    for (int column = 0; column < 3; column++) {
+        float scaleSquared = m[column][0] * m[column][0] + m[column][1] * m[column][1] + m[column][2] * m[column][2];
+        maxScaleSquared = scaleSquared > maxScaleSquared ? scaleSquared : maxScaleSquared;
+    }
+    float radius = bounds.sphereRadius * sqrtf(maxScaleSquared);
+
+    // AABB: transformed center, extents projected onto the world axes through |M|
+    float cx = (bounds.aabbMin[0] + bounds.aabbMax[0]) * 0.5f;
+    float cy = (bounds.aabbMin[1] + bounds.aabbMax[1]) * 0.5f;
+    float cz = (bounds.aabbMin[2] + bounds.aabbMax[2]) * 0.5f;
+    float ex = (bounds.aabbMax[0] - bounds.aabbMin[0]) * 0.5f;
+    float ey = (bounds.aabbMax[1] - bounds.aabbMin[1]) * 0.5f;
+    float ez = (bounds.aabbMax[2] - bounds.aabbMin[2]) * 0.5f;
+
+    float boxX = m[0][0] * cx + m[1][0] * cy + m[2][0] * cz + m[3][0];
+    float boxY = m[0][1] * cx + m[1][1] * cy + m[2][1] * cz + m[3][1];
+    float boxZ = m[0][2] * cx + m[1][2] * cy + m[2][2] * cz + m[3][2];
+    float extentX = fabsf(m[0][0]) * ex + fabsf(m[1][0]) * ey + fabsf(m[2][0]) * ez;
+    float extentY = fabsf(m[0][1]) * ex + fabsf(m[1][1]) * ey + fabsf(m[2][1]) * ez;
+    float extentZ = fabsf(m[0][2]) * ex + fabsf(m[1][2]) * ey + fabsf(m[2][2]) * ez;
+
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    const __m128 zero = _mm_setzero_ps();
+
+    __m128 sphereCenterX = _mm_set1_ps(sphereX);
+    __m128 sphereCenterY = _mm_set1_ps(sphereY);
+    __m128 sphereCenterZ = _mm_set1_ps(sphereZ);
+    __m128 negativeRadius = _mm_set1_ps(-radius);
+
+    __m128 boxCenterX = _mm_set1_ps(boxX);
+    __m128 boxCenterY = _mm_set1_ps(boxY);
+    __m128 boxCenterZ = _mm_set1_ps(boxZ);
+    __m128 boxExtentX = _mm_set1_ps(extentX);
+    __m128 boxExtentY = _mm_set1_ps(extentY);
+    __m128 boxExtentZ = _mm_set1_ps(extentZ);
+
+    for (int group = 0; group < 2; group++) {
+        // Sphere entirely behind any plane
+        __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[group], sphereCenterX), _mm_mul_ps(planeY[group], sphereCenterY)),
+            _mm_add_ps(_mm_mul_ps(planeZ[group], sphereCenterZ), planeD[group]));
+        if (_mm_movemask_ps(_mm_cmplt_ps(distance, negativeRadius))) {
+            return false;
+        }
+
+        // Box entirely behind any plane: center distance plus the box's projected half-size
+        __m128 boxDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[group], boxCenterX), _mm_mul_ps(planeY[group], boxCenterY)),
+            _mm_add_ps(_mm_mul_ps(planeZ[group], boxCenterZ), planeD[group]));
+        __m128 boxRadius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, planeX[group]), boxExtentX),
+            _mm_mul_ps(_mm_andnot_ps(signMask, planeY[group]), boxExtentY)),
+            _mm_mul_ps(_mm_andnot_ps(signMask, planeZ[group]), boxExtentZ));
+        if (_mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(boxDistance, boxRadius), zero))) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool Frustum::isSphereVisible(const vmath::vec3& center, float radius) const {
+    __m128 centerX = _mm_set1_ps(center[0]);
+    __m128 centerY = _mm_set1_ps(center[1]);
+    __m128 centerZ = _mm_set1_ps(center[2]);
+    __m128 negativeRadius = _mm_set1_ps(-radius);
+
+    for (int group = 0; group < 2; group++) {
+        __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[group], centerX), _mm_mul_ps(planeY[group], centerY)),
+            _mm_add_ps(_mm_mul_ps(planeZ[group], centerZ), planeD[group]));
+        if (_mm_movemask_ps(_mm_cmplt_ps(distance, negativeRadius))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Frustum::getPlanes(vmath::vec4 planes[6]) const {
+    float x[8], y[8], z[8], d[8];
+    for (int group = 0; group < 2; group++) {
+        _mm_storeu_ps(x + group * 4, planeX[group]);
+        _mm_storeu_ps(y + group * 4, planeY[group]);
+        _mm_storeu_ps(z + group * 4, planeZ[group]);
+        _mm_storeu_ps(d + group * 4, planeD[group]);
+    }
+
+    for (int i = 0; i < 6; i++) {
+        planes[i] = vmath::vec4(x[i], y[i], z[i], d[i]);
+    }
+}
@@ -0,0 +1,255 @@
+#include "../headers/GeometryArena.h"
+#include <iterator>
+
+void RangeAllocator::reset(unsigned int initialCapacity) {
+    freeRanges.clear();
+    capacity = initialCapacity;
+    if (capacity > 0) {
+        freeRanges[0] = capacity;
+    }
+}
+
+bool RangeAllocator::allocate(unsigned int count, unsigned int& offset) {
+    if (count == 0) {
+        offset = 0;
+        return true;
+    }
+
+    // Best fit keeps large ranges intact for large meshes
+    std::map<unsigned int, unsigned int>::iterator best = freeRanges.end();
+    for (std::map<unsigned int, unsigned int>::iterator it = freeRanges.begin(); it != freeRanges.end(); ++it) {
+        if (it->second >= count && (best == freeRanges.end() || it->second < best->second)) {
+            best = it;
+            if (it->second == count) {
+                break;
+            }
+        }
+    }
+
+    if (best == freeRanges.end()) {
+        return false;
+    }
+
+    offset = best->first;
+    unsigned int remaining = best->second - count;
+    freeRanges.erase(best);
+    if (remaining > 0) {
+        freeRanges[offset + count] = remaining;
+    }
+
+    return true;
+}
+
+void RangeAllocator::free(unsigned int offset, unsigned int count) {
+    if (count == 0) {
+        return;
+    }
+
+    std::map<unsigned int, unsigned int>::iterator next = freeRanges.lower_bound(offset);
+
+    // Merge with the following range
+    if (next != freeRanges.end() && offset + count == next->first) {
+        count += next->second;
+        next = freeRanges.erase(next);
+    }
+
+    // Merge with the preceding range
+    if (next != freeRanges.begin()) {
+        std::map<unsigned int, unsigned int>::iterator previous = std::prev(next);
+        if (previous->first + previous->second == offset) {
+            previous->second += count;
+            return;
+        }
+    }
+
+    freeRanges[offset] = count;
+}
+
+void RangeAllocator::grow(unsigned int newCapacity) {
+    if (newCapacity <= capacity) {
+        return;
+    }
+
+    unsigned int oldCapacity = capacity;
+    capacity = newCapacity;
+    free(oldCapacity, newCapacity - oldCapacity);
+}
+
+unsigned int RangeAllocator::getLargestFreeRange() const {
+    unsigned int largest = 0;
+    for (std::map<unsigned int, unsigned int>::const_iterator it = freeRanges.begin(); it != freeRanges.end(); ++it) {
+        if (it->second > largest) {
+            largest = it->second;
+        }
+    }
+    return largest;
+}
+
+// Allocates a bigger buffer and copies the old contents over on the GPU
+static GLuint resizeBuffer(GLuint oldBuffer, size_t oldSize, size_t newSize) {
+    GLuint newBuffer;
+    glGenBuffers(1, &newBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, newSize, NULL, GL_STATIC_DRAW);
+
+    if (oldBuffer) {
+        if (oldSize > 0) {
+            glBindBuffer(GL_COPY_READ_BUFFER, oldBuffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize);
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        }
+        glDeleteBuffers(1, &oldBuffer);
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return newBuffer;
+}
+
+GeometryArena::GeometryArena() : uploadRing(nullptr), vertexBuffer(0) {
+    indexPools[0].type = GL_UNSIGNED_SHORT;
+    indexPools[1].type = GL_UNSIGNED_INT;
+    for (IndexPool& pool : indexPools) {
+        pool.vao = 0;
+        pool.buffer = 0;
+    }
+}
+
+GLenum GeometryArena::selectIndexType(unsigned int vertexCount) {
+    return vertexCount <= kMaxShortIndexVertices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+size_t GeometryArena::getIndexSize(GLenum indexType) {
+    return indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+}
+
+void GeometryArena::startup(const VertexFormat& vertexFormat, unsigned int vertexCapacity, unsigned int indexCapacity, UploadRing* ring) {
+    format = vertexFormat;
+    uploadRing = ring;
+
+    vertexAllocator.reset(0);
+
+    for (IndexPool& pool : indexPools) {
+        pool.allocator.reset(0);
+
+        glGenVertexArrays(1, &pool.vao);
+        glBindVertexArray(pool.vao);
+
+        // Attribute layout lives in the VAO; the buffer behind binding 0 can be swapped when growing
+        for (const VertexAttribute& attribute : format.attributes) {
+            glVertexAttribFormat(attribute.location, attribute.components, attribute.type, attribute.normalized, attribute.offset);
+            glVertexAttribBinding(attribute.location, 0);
+            glEnableVertexAttribArray(attribute.location);
+        }
+    }
+
+    glBindVertexArray(0);
+
+    growVertexBuffer(vertexCapacity);
+    for (IndexPool& pool : indexPools) {
+        growIndexBuffer(pool, indexCapacity);
+    }
+}
+
+void GeometryArena::shutdown() {
+    for (IndexPool& pool : indexPools) {
+        glDeleteVertexArrays(1, &pool.vao);
+        glDeleteBuffers(1, &pool.buffer);
+        pool.vao = pool.buffer = 0;
+        pool.allocator.reset(0);
+    }
+
+    glDeleteBuffers(1, &vertexBuffer);
+    vertexBuffer = 0;
+    vertexAllocator.reset(0);
+}
+
+bool GeometryArena::allocate(unsigned int vertexCount, unsigned int indexCount, Range& range) {
+    range.vertexCount = vertexCount;
+    range.indexCount = indexCount;
+    range.indexType = selectIndexType(vertexCount);
+
+    if (!vertexAllocator.allocate(vertexCount, range.baseVertex)) {
+        growVertexBuffer(vertexAllocator.getCapacity() + vertexCount);
+        if (!vertexAllocator.allocate(vertexCount, range.baseVertex)) {
+            return false;
+        }
+    }
+
+    IndexPool& pool = getPool(range.indexType);
+    if (!pool.allocator.allocate(indexCount, range.firstIndex)) {
+        growIndexBuffer(pool, pool.allocator.getCapacity() + indexCount);
+        if (!pool.allocator.allocate(indexCount, range.firstIndex)) {
+            vertexAllocator.free(range.baseVertex, vertexCount);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void GeometryArena::free(const Range& range) {
+    vertexAllocator.free(range.baseVertex, range.vertexCount);
+    getPool(range.indexType).allocator.free(range.firstIndex, range.indexCount);
+}
+
+UploadRing::Ticket GeometryArena::upload(const Range& range, const void* vertices, const unsigned int* indices) {
+    uploadRing->queueBuffer(vertexBuffer, (GLintptr)range.baseVertex * format.stride, vertices, (size_t)range.vertexCount * format.stride);
+
+    const IndexPool& pool = getPool(range.indexType);
+    size_t indexSize = getIndexSize(range.indexType);
+    if (range.indexType == GL_UNSIGNED_SHORT) {
+        // The ring copies the data at queue time, so the narrowed copy can be temporary
+        std::vector<unsigned short> narrowed(indices, indices + range.indexCount);
+        return uploadRing->queueBuffer(pool.buffer, (GLintptr)range.firstIndex * indexSize, narrowed.data(), (size_t)range.indexCount * indexSize);
+    }
+    return uploadRing->queueBuffer(pool.buffer, (GLintptr)range.firstIndex * indexSize, indices, (size_t)range.indexCount * indexSize);
+}
+
+void GeometryArena::growVertexBuffer(unsigned int minCapacity) {
+    unsigned int oldCapacity = vertexAllocator.getCapacity();
+    unsigned int newCapacity = oldCapacity > 0 ? oldCapacity : 1;
+    while (newCapacity < minCapacity) {
+        newCapacity *= 2;
+    }
+
+    // The upload thread must not write to the old buffer between the copy and the retarget
+    GLuint oldBuffer = vertexBuffer;
+    uploadRing->pause();
+    vertexBuffer = resizeBuffer(oldBuffer, (size_t)oldCapacity * format.stride, (size_t)newCapacity * format.stride);
+    if (oldBuffer) {
+        uploadRing->retargetBuffer(oldBuffer, vertexBuffer);
+    }
+    uploadRing->resume();
+
+    for (IndexPool& pool : indexPools) {
+        glBindVertexArray(pool.vao);
+        glBindVertexBuffer(0, vertexBuffer, 0, format.stride);
+    }
+    glBindVertexArray(0);
+
+    vertexAllocator.grow(newCapacity);
+}
+
+void GeometryArena::growIndexBuffer(IndexPool& pool, unsigned int minCapacity) {
+    unsigned int oldCapacity = pool.allocator.getCapacity();
+    unsigned int newCapacity = oldCapacity > 0 ? oldCapacity : 1;
+    while (newCapacity < minCapacity) {
+        newCapacity *= 2;
+    }
+
+    // The upload thread must not write to the old buffer between the copy and the retarget
+    size_t indexSize = getIndexSize(pool.type);
+    GLuint oldBuffer = pool.buffer;
+    uploadRing->pause();
+    pool.buffer = resizeBuffer(oldBuffer, (size_t)oldCapacity * indexSize, (size_t)newCapacity * indexSize);
+    if (oldBuffer) {
+        uploadRing->retargetBuffer(oldBuffer, pool.buffer);
+    }
+    uploadRing->resume();
+
+    glBindVertexArray(pool.vao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pool.buffer);
+    glBindVertexArray(0);
+
+    pool.allocator.grow(newCapacity);
+}
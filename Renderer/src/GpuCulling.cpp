@@ -0,0 +1,221 @@
+#include "../headers/GpuCulling.h"
+#include "../headers/LevelOfDetail.h"
+#include <string.h>
+
+static const GLuint kFeedbackHeaderWords = 4; // drawCount, visibleInstances, triangles, culledRecords
+
+GpuCulling::GpuCulling() : program(0), viewLocation(-1), animationLocation(-1), planesLocation(-1),
+    projScaleLocation(-1), screenHeightLocation(-1), wideCommandStartLocation(-1), maxPixelErrorLocation(-1), lodHysteresisLocation(-1), recordBuffer(0), commandBuffer(0),
+    commandRecordBuffer(0), visibleInstanceBuffer(0), drawCountBuffer(0), recordCount(0), shortRecordCount(0), nextSlot(0) {
+    for (FeedbackSlot& slot : feedbackSlots) {
+        slot.buffer = 0;
+        slot.materialCount = 0;
+        slot.fence = 0;
+    }
+}
+
+bool GpuCulling::isSupported() {
+    bool indirectCount = gl3wIsSupported(4, 6) || glfwExtensionSupported("GL_ARB_indirect_parameters");
+    bool drawParameters = gl3wIsSupported(4, 6) || glfwExtensionSupported("GL_ARB_shader_draw_parameters");
+    return gl3wIsSupported(4, 3) && indirectCount && drawParameters && glMultiDrawElementsIndirectCountARB != NULL;
+}
+
+void GpuCulling::startup() {
+    GLuint computeShader = ES::LoadShader("shaders/cull.cs.glsl", GL_COMPUTE_SHADER);
+    program = glCreateProgram();
+    glAttachShader(program, computeShader);
+    glLinkProgram(program);
+    glDeleteShader(computeShader);
+
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        OutputDebugStringA("\nFailed to link culling compute shader");
+    }
+
+    viewLocation = glGetUniformLocation(program, "viewMatrix");
+    animationLocation = glGetUniformLocation(program, "animationMatrix");
+    planesLocation = glGetUniformLocation(program, "frustumPlanes");
+    projScaleLocation = glGetUniformLocation(program, "projScale");
+    screenHeightLocation = glGetUniformLocation(program, "screenHeight");
+    wideCommandStartLocation = glGetUniformLocation(program, "wideCommandStart");
+    maxPixelErrorLocation = glGetUniformLocation(program, "maxPixelError");
+    lodHysteresisLocation = glGetUniformLocation(program, "lodHysteresis");
+
+    glGenBuffers(1, &recordBuffer);
+    glGenBuffers(1, &commandBuffer);
+    glGenBuffers(1, &commandRecordBuffer);
+    glGenBuffers(1, &visibleInstanceBuffer);
+    glGenBuffers(1, &drawCountBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawCountBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, 2 * sizeof(GLuint), NULL, GL_DYNAMIC_DRAW); // 16-bit and 32-bit counts
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    for (FeedbackSlot& slot : feedbackSlots) {
+        glGenBuffers(1, &slot.buffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, slot.buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, kFeedbackHeaderWords * sizeof(GLuint), NULL, GL_DYNAMIC_READ);
+        slot.materialCount = 0;
+        slot.fence = 0;
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    nextSlot = 0;
+    recordCount = 0;
+    shortRecordCount = 0;
+}
+
+void GpuCulling::shutdown() {
+    for (FeedbackSlot& slot : feedbackSlots) {
+        if (slot.fence) {
+            glDeleteSync(slot.fence);
+        }
+        glDeleteBuffers(1, &slot.buffer);
+        slot.buffer = 0;
+        slot.fence = 0;
+    }
+
+    glDeleteBuffers(1, &recordBuffer);
+    glDeleteBuffers(1, &commandBuffer);
+    glDeleteBuffers(1, &commandRecordBuffer);
+    glDeleteBuffers(1, &visibleInstanceBuffer);
+    glDeleteBuffers(1, &drawCountBuffer);
+    recordBuffer = commandBuffer = commandRecordBuffer = visibleInstanceBuffer = drawCountBuffer = 0;
+    glDeleteProgram(program);
+    program = 0;
+    recordCount = 0;
+}
+
+void GpuCulling::setRecords(std::vector<DrawRecord>& records) {
+    // Every record gets room for all of its instances, so the shader never has to allocate
+    GLuint visibleCapacity = 0;
+    shortRecordCount = 0;
+    for (DrawRecord& record : records) {
+        record.outputOffset = visibleCapacity;
+        visibleCapacity += record.instanceCount;
+        shortRecordCount += record.wideIndices ? 0 : 1;
+    }
+    recordCount = (GLuint)records.size();
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, recordBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, records.size() * sizeof(DrawRecord), records.data(), GL_STATIC_DRAW);
+
+    // Outputs are sized for the worst case of everything visible
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, records.size() * 5 * sizeof(GLuint), NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandRecordBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, records.size() * sizeof(GLuint), NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, visibleInstanceBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, (size_t)visibleCapacity * sizeof(GLuint), NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void GpuCulling::cull(const Frustum& frustum, const vmath::mat4& viewMatrix, const vmath::mat4& animationMatrix,
+    float projScale, float screenHeight, GLuint materialCount) {
+    const GLuint zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawCountBuffer);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+    // Results this slot held were either taken already or are dropped now
+    FeedbackSlot& slot = feedbackSlots[nextSlot];
+    nextSlot = (nextSlot + 1) % kReadbackFrames;
+    if (slot.fence) {
+        glDeleteSync(slot.fence);
+        slot.fence = 0;
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, slot.buffer);
+    if (slot.materialCount != materialCount) {
+        slot.materialCount = materialCount;
+        glBufferData(GL_SHADER_STORAGE_BUFFER, (kFeedbackHeaderWords + materialCount) * sizeof(GLuint), NULL, GL_DYNAMIC_READ);
+    }
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    if (recordCount > 0) {
+        vmath::vec4 planes[6];
+        frustum.getPlanes(planes);
+
+        glUseProgram(program);
+        glUniformMatrix4fv(viewLocation, 1, GL_FALSE, viewMatrix);
+        glUniformMatrix4fv(animationLocation, 1, GL_FALSE, animationMatrix);
+        glUniform4fv(planesLocation, 6, planes[0]);
+        glUniform1f(projScaleLocation, projScale);
+        glUniform1f(screenHeightLocation, screenHeight);
+        glUniform1ui(wideCommandStartLocation, shortRecordCount);
+        glUniform1f(maxPixelErrorLocation, LevelOfDetail::kMaxPixelError);
+        glUniform1f(lodHysteresisLocation, LevelOfDetail::kHysteresis);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kRecordBinding, recordBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kCommandBinding, commandBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kCommandRecordBinding, commandRecordBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kVisibleInstanceBinding, visibleInstanceBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kDrawCountBinding, drawCountBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kFeedbackBinding, slot.buffer);
+
+        // One workgroup per record; its threads stride over the record's instances
+        glDispatchCompute(recordCount, 1, 1);
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+int GpuCulling::draw(const GeometryArena& geometryArena, GLint drawOffsetLocation, int& bindCount) {
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    glBindBuffer(GL_PARAMETER_BUFFER_ARB, drawCountBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kRecordBinding, recordBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kCommandRecordBinding, commandRecordBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kVisibleInstanceBinding, visibleInstanceBuffer);
+    bindCount += 5;
+
+    // The count of each group is read from its own slot of the draw count buffer
+    const GLenum indexTypes[] = { GL_UNSIGNED_SHORT, GL_UNSIGNED_INT };
+    const GLuint firstCommands[] = { 0, shortRecordCount };
+    const GLuint maxCounts[] = { shortRecordCount, recordCount - shortRecordCount };
+    int drawCount = 0;
+    for (int i = 0; i < 2; i++) {
+        if (maxCounts[i] == 0) {
+            continue;
+        }
+
+        glBindVertexArray(geometryArena.getVAO(indexTypes[i]));
+        glUniform1ui(drawOffsetLocation, firstCommands[i]);
+        glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, indexTypes[i], (GLintptr)firstCommands[i] * 5 * sizeof(GLuint),
+            (GLintptr)i * sizeof(GLuint), (GLsizei)maxCounts[i], 0);
+        bindCount++;
+        drawCount++;
+    }
+
+    glBindBuffer(GL_PARAMETER_BUFFER_ARB, 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    return drawCount;
+}
+
+bool GpuCulling::takeFeedback(Feedback& feedback) {
+    // The slot cull() reuses next is the oldest one in flight
+    FeedbackSlot& slot = feedbackSlots[nextSlot];
+    if (!slot.fence || glClientWaitSync(slot.fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+        return false;
+    }
+    glDeleteSync(slot.fence);
+    slot.fence = 0;
+
+    std::vector<GLuint> words(kFeedbackHeaderWords + slot.materialCount);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, slot.buffer);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, words.size() * sizeof(GLuint), words.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    feedback.drawCount = words[0];
+    feedback.visibleInstances = words[1];
+    feedback.triangles = words[2];
+    feedback.culledRecords = words[3];
+
+    // Sizes were stored as float bits; for positive floats the integer order matches
+    feedback.materialSizes.resize(slot.materialCount);
+    for (GLuint i = 0; i < slot.materialCount; i++) {
+        float size;
+        memcpy(&size, &words[kFeedbackHeaderWords + i], sizeof(size));
+        feedback.materialSizes[i] = size;
+    }
+    return true;
+}
@@ -0,0 +1,88 @@
+#include "../headers/InstanceBuffer.h"
+#include <algorithm>
+
+InstanceBuffer::InstanceBuffer() : buffer(0), dirtyBegin(0), dirtyEnd(0) {
+}
+
+void InstanceBuffer::startup(unsigned int initialCapacity) {
+    allocator.reset(0);
+    transforms.clear();
+    glGenBuffers(1, &buffer);
+    grow(initialCapacity);
+}
+
+void InstanceBuffer::shutdown() {
+    glDeleteBuffers(1, &buffer);
+    buffer = 0;
+    transforms.clear();
+    allocator.reset(0);
+    dirtyBegin = dirtyEnd = 0;
+}
+
+bool InstanceBuffer::allocate(unsigned int count, unsigned int& first) {
+    if (!allocator.allocate(count, first)) {
+        grow(allocator.getCapacity() + count);
+        if (!allocator.allocate(count, first)) {
+            return false;
+        }
+    }
+
+    for (unsigned int i = first; i < first + count; i++) {
+        setTransform(i, vmath::mat4::identity());
+    }
+    return true;
+}
+
+void InstanceBuffer::free(unsigned int first, unsigned int count) {
+    if (count > 0) {
+        allocator.free(first, count);
+    }
+}
+
+void InstanceBuffer::setTransform(unsigned int index, const vmath::mat4& transform) {
+    transforms[index] = transform;
+
+    if (dirtyBegin == dirtyEnd) {
+        dirtyBegin = index;
+        dirtyEnd = index + 1;
+    }
+    else {
+        dirtyBegin = std::min(dirtyBegin, index);
+        dirtyEnd = std::max(dirtyEnd, index + 1);
+    }
+}
+
+size_t InstanceBuffer::flush() {
+    if (dirtyBegin == dirtyEnd) {
+        return 0;
+    }
+
+    size_t offset = (size_t)dirtyBegin * sizeof(vmath::mat4);
+    size_t bytes = (size_t)(dirtyEnd - dirtyBegin) * sizeof(vmath::mat4);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, offset, bytes, &transforms[dirtyBegin]);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    dirtyBegin = dirtyEnd = 0;
+    return bytes;
+}
+
+void InstanceBuffer::bind() const {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kBufferBinding, buffer);
+}
+
+void InstanceBuffer::grow(unsigned int minCapacity) {
+    unsigned int newCapacity = allocator.getCapacity() > 0 ? allocator.getCapacity() : 1;
+    while (newCapacity < minCapacity) {
+        newCapacity *= 2;
+    }
+
+    transforms.resize(newCapacity, vmath::mat4::identity());
+    allocator.grow(newCapacity);
+
+    // New storage gets the whole CPU copy, so nothing is left dirty
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, transforms.size() * sizeof(vmath::mat4), transforms.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    dirtyBegin = dirtyEnd = 0;
+}
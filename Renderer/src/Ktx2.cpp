@@ -0,0 +1,141 @@
+#include "../headers/Ktx2.h"
+#include "../headers/TextureCompression.h"
+#include "SharedUtilities.h"
+#include <string.h>
+
+namespace Ktx2 {
+    static const unsigned char kIdentifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+    // VkFormat values the renderer can upload without transcoding
+    enum VkFormat {
+        VkFormat_Undefined = 0, // Basis Universal payloads
+        VkFormat_R8G8B8_UNORM = 23,
+        VkFormat_R8G8B8_SRGB = 29,
+        VkFormat_R8G8B8A8_UNORM = 37,
+        VkFormat_R8G8B8A8_SRGB = 43,
+        VkFormat_BC1_RGB_UNORM = 131,
+        VkFormat_BC1_RGB_SRGB = 132,
+        VkFormat_BC5_UNORM = 141,
+        VkFormat_BC7_UNORM = 145,
+        VkFormat_BC7_SRGB = 146
+    };
+
+    enum Supercompression {
+        Supercompression_None = 0,
+        Supercompression_BasisLZ = 1,
+        Supercompression_Zstandard = 2,
+        Supercompression_ZLIB = 3
+    };
+
+    struct Header {
+        unsigned char identifier[12];
+        unsigned int vkFormat;
+        unsigned int typeSize;
+        unsigned int pixelWidth;
+        unsigned int pixelHeight;
+        unsigned int pixelDepth;
+        unsigned int layerCount;
+        unsigned int faceCount;
+        unsigned int levelCount;
+        unsigned int supercompressionScheme;
+        unsigned int dfdByteOffset;
+        unsigned int dfdByteLength;
+        unsigned int kvdByteOffset;
+        unsigned int kvdByteLength;
+        unsigned long long sgdByteOffset;
+        unsigned long long sgdByteLength;
+    };
+
+    struct LevelIndex {
+        unsigned long long byteOffset;
+        unsigned long long byteLength;
+        unsigned long long uncompressedByteLength;
+    };
+
+    static bool getTextureFormat(unsigned int vkFormat, TextureFormat& format) {
+        switch (vkFormat) {
+        case VkFormat_R8G8B8_UNORM:
+        case VkFormat_R8G8B8_SRGB: format = TextureFormat_RGB8; return true;
+        case VkFormat_R8G8B8A8_UNORM:
+        case VkFormat_R8G8B8A8_SRGB: format = TextureFormat_RGBA8; return true;
+        case VkFormat_BC1_RGB_UNORM:
+        case VkFormat_BC1_RGB_SRGB: format = TextureFormat_BC1; return true;
+        case VkFormat_BC5_UNORM: format = TextureFormat_BC5; return true;
+        case VkFormat_BC7_UNORM:
+        case VkFormat_BC7_SRGB: format = TextureFormat_BC7; return true;
+        default: return false;
+        }
+    }
+
+    bool isKtx2(const unsigned char* data, size_t size) {
+        return size >= sizeof(kIdentifier) && memcmp(data, kIdentifier, sizeof(kIdentifier)) == 0;
+    }
+
+    bool load(const unsigned char* data, size_t size, TextureData& textureData) {
+        Header header;
+        if (size < sizeof(Header) || !isKtx2(data, size)) {
+            return false;
+        }
+        memcpy(&header, data, sizeof(Header));
+
+        if (header.supercompressionScheme == Supercompression_BasisLZ || header.vkFormat == VkFormat_Undefined) {
+            OutputDebugStringA("\nKTX2 texture holds a Basis Universal payload, which needs the Basis transcoder");
+            return false;
+        }
+        if (header.supercompressionScheme != Supercompression_None) {
+            OutputDebugStringA("\nKTX2 texture uses Zstandard/ZLIB supercompression, which isn't supported");
+            return false;
+        }
+
+        TextureFormat format;
+        if (!getTextureFormat(header.vkFormat, format)) {
+            OutputDebugStringA("\nKTX2 texture format not supported");
+            return false;
+        }
+
+        // Plain 2D textures only: no depth, array layers or cube faces
+        if (header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth > 1
+            || header.layerCount > 1 || header.faceCount != 1 || header.levelCount > 32) {
+            OutputDebugStringA("\nKTX2 texture is not a plain 2D texture");
+            return false;
+        }
+
+        // levelCount 0 asks the loader to generate mips
+        unsigned int levelCount = header.levelCount > 0 ? header.levelCount : 1;
+        if (sizeof(Header) + (unsigned long long)levelCount * sizeof(LevelIndex) > size) {
+            return false;
+        }
+
+        TextureData result;
+        result.width = (int)header.pixelWidth;
+        result.height = (int)header.pixelHeight;
+        result.channels = format == TextureFormat_RGB8 || format == TextureFormat_BC1 ? 3 : 4;
+        result.format = format;
+        result.mips.resize(levelCount);
+
+        int width = result.width;
+        int height = result.height;
+        for (unsigned int level = 0; level < levelCount; level++) {
+            LevelIndex index;
+            memcpy(&index, data + sizeof(Header) + level * sizeof(LevelIndex), sizeof(LevelIndex));
+
+            if (index.byteLength != TextureCompression::getLevelBytes(format, width, height)
+                || index.byteOffset > size || index.byteLength > size - index.byteOffset) {
+                OutputDebugStringA("\nKTX2 texture has a malformed level index");
+                return false;
+            }
+
+            result.mips[level].assign(data + index.byteOffset, data + index.byteOffset + index.byteLength);
+            width = width > 1 ? width / 2 : 1;
+            height = height > 1 ? height / 2 : 1;
+        }
+
+        // Block data can't be filtered here, so a short chain of it is kept as it is
+        if (levelCount == 1 && !TextureCompression::isBlockFormat(format)) {
+            buildMipChain(result);
+        }
+
+        textureData = std::move(result);
+        return true;
+    }
+}
@@ -0,0 +1,508 @@
+#include "../headers/LevelOfDetail.h"
+#include "../headers/MeshImport.h"
+#include "../headers/MeshOptimization.h"
+#include <algorithm>
+#include <math.h>
+
+namespace LevelOfDetail {
+    static const size_t kMinTriangles = 64;      // Smaller meshes and levels aren't simplified further
+    static const float kMinReduction = 0.8f;     // A level must have at most this fraction of the previous level's indices
+    static const float kMaxRelativeError = 0.05f; // Error budget of a whole chain, relative to the bounding sphere radius
+    static const double kBorderWeight = 10.0;    // Keeps open borders in place more firmly than surfaces
+    static const float kNormalWeight = 0.5f;
+
+    enum VertexKind {
+        Kind_Manifold, // Moves onto any neighbour
+        Kind_Border,   // Moves along the open border it sits on
+        Kind_Seam,     // One of two vertices at a position; both move along the seam together
+        Kind_Locked    // Corners of seams and borders, non-manifold vertices
+    };
+
+    // Symmetric 4x4 matrix of summed squared plane distances; weight is the triangle area behind it
+    struct Quadric {
+        double a00, a01, a02, a03, a11, a12, a13, a22, a23, a33;
+        double weight;
+    };
+
+    struct Collapse {
+        unsigned int from;
+        unsigned int to;
+        float cost;
+    };
+
+    // Triangles around each vertex, as ranges of one shared list
+    struct Adjacency {
+        std::vector<unsigned int> offsets;
+        std::vector<unsigned int> triangles;
+    };
+
+    static void addPlane(Quadric& quadric, double a, double b, double c, double d, double weight) {
+        quadric.a00 += a * a * weight;
+        quadric.a01 += a * b * weight;
+        quadric.a02 += a * c * weight;
+        quadric.a03 += a * d * weight;
+        quadric.a11 += b * b * weight;
+        quadric.a12 += b * c * weight;
+        quadric.a13 += b * d * weight;
+        quadric.a22 += c * c * weight;
+        quadric.a23 += c * d * weight;
+        quadric.a33 += d * d * weight;
+    }
+
+    static void addQuadric(Quadric& quadric, const Quadric& other) {
+        quadric.a00 += other.a00;
+        quadric.a01 += other.a01;
+        quadric.a02 += other.a02;
+        quadric.a03 += other.a03;
+        quadric.a11 += other.a11;
+        quadric.a12 += other.a12;
+        quadric.a13 += other.a13;
+        quadric.a22 += other.a22;
+        quadric.a23 += other.a23;
+        quadric.a33 += other.a33;
+        quadric.weight += other.weight;
+    }
+
+    static double evaluate(const Quadric& quadric, const float* position) {
+        double x = position[0];
+        double y = position[1];
+        double z = position[2];
+        return quadric.a00 * x * x + 2.0 * quadric.a01 * x * y + 2.0 * quadric.a02 * x * z + 2.0 * quadric.a03 * x
+            + quadric.a11 * y * y + 2.0 * quadric.a12 * y * z + 2.0 * quadric.a13 * y
+            + quadric.a22 * z * z + 2.0 * quadric.a23 * z + quadric.a33;
+    }
+
+    static unsigned long long edgeKey(unsigned int a, unsigned int b) {
+        return a < b ? ((unsigned long long)a << 32) | b : ((unsigned long long)b << 32) | a;
+    }
+
+    static void buildAdjacency(const std::vector<unsigned int>& indices, size_t vertexCount, Adjacency& adjacency) {
+        adjacency.offsets.assign(vertexCount + 1, 0);
+        for (unsigned int index : indices) {
+            adjacency.offsets[index + 1]++;
+        }
+        for (size_t i = 0; i < vertexCount; i++) {
+            adjacency.offsets[i + 1] += adjacency.offsets[i];
+        }
+
+        std::vector<unsigned int> cursors(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+        adjacency.triangles.resize(indices.size());
+        for (size_t i = 0; i < indices.size(); i++) {
+            adjacency.triangles[cursors[indices[i]]++] = (unsigned int)(i / 3);
+        }
+    }
+
+    static void cross(const float* a, const float* b, float* out) {
+        out[0] = a[1] * b[2] - a[2] * b[1];
+        out[1] = a[2] * b[0] - a[0] * b[2];
+        out[2] = a[0] * b[1] - a[1] * b[0];
+    }
+
+    static void triangleNormal(const float* p0, const float* p1, const float* p2, float* normal) {
+        float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+        float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+        cross(e1, e2, normal);
+    }
+
+    // Working state of one simplify() call
+    class Simplifier {
+    public:
+        Simplifier(const std::vector<float>& vertices, const std::vector<unsigned int>& indices)
+            : vertices(vertices), vertexCount(vertices.size() / MeshImport::kFloatsPerVertex) {
+            buildWedges(indices);
+            classifyVertices(indices);
+            buildQuadrics(indices);
+        }
+
+        // One round of non-overlapping collapses, cheapest first. Returns false when none was possible.
+        bool collapse(std::vector<unsigned int>& indices, size_t targetIndexCount, float maxError, float& error) {
+            buildAdjacency(indices, vertexCount, adjacency);
+
+            std::vector<unsigned long long> edges;
+            edges.reserve(indices.size());
+            for (size_t i = 0; i < indices.size(); i += 3) {
+                for (int corner = 0; corner < 3; corner++) {
+                    edges.push_back(edgeKey(indices[i + corner], indices[i + (corner + 1) % 3]));
+                }
+            }
+            std::sort(edges.begin(), edges.end());
+            edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+            std::vector<Collapse> collapses;
+            for (unsigned long long edge : edges) {
+                unsigned int a = (unsigned int)(edge >> 32);
+                unsigned int b = (unsigned int)(edge & 0xFFFFFFFFu);
+                float costAB = getCost(indices, a, b);
+                float costBA = getCost(indices, b, a);
+                Collapse best = costAB <= costBA ? Collapse{ a, b, costAB } : Collapse{ b, a, costBA };
+                if (best.cost <= maxError) {
+                    collapses.push_back(best);
+                }
+            }
+            std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+                return a.cost < b.cost;
+            });
+
+            // An interior collapse removes two triangles; stopping at the target keeps the level close to it
+            size_t goal = (indices.size() - targetIndexCount) / 6 + 1;
+            std::vector<unsigned int> remap(vertexCount);
+            for (size_t i = 0; i < vertexCount; i++) {
+                remap[i] = (unsigned int)i;
+            }
+            std::vector<unsigned char> touched(vertexCount, 0);
+
+            size_t applied = 0;
+            for (const Collapse& collapse : collapses) {
+                if (applied >= goal) {
+                    break;
+                }
+
+                unsigned int from = collapse.from;
+                unsigned int to = collapse.to;
+                bool seam = kinds[from] == Kind_Seam;
+                if (touched[from] || touched[to] || (seam && (touched[twins[from]] || touched[twins[to]]))) {
+                    continue;
+                }
+                if (flips(indices, from, to) || (seam && flips(indices, twins[from], twins[to]))) {
+                    continue;
+                }
+
+                remap[from] = to;
+                if (seam) {
+                    remap[twins[from]] = twins[to];
+                }
+                touchWedge(from, touched);
+                touchWedge(to, touched);
+
+                addQuadric(quadrics[positions[to]], quadrics[positions[from]]);
+                error = std::max(error, collapse.cost);
+                applied++;
+            }
+
+            if (applied == 0) {
+                return false;
+            }
+
+            // Triangles that had both ends of a collapsed edge are gone
+            size_t kept = 0;
+            for (size_t i = 0; i < indices.size(); i += 3) {
+                unsigned int a = remap[indices[i]];
+                unsigned int b = remap[indices[i + 1]];
+                unsigned int c = remap[indices[i + 2]];
+                if (a != b && b != c && a != c) {
+                    indices[kept++] = a;
+                    indices[kept++] = b;
+                    indices[kept++] = c;
+                }
+            }
+            indices.resize(kept);
+            return true;
+        }
+
+    private:
+        const float* getPosition(unsigned int vertex) const {
+            return &vertices[(size_t)vertex * MeshImport::kFloatsPerVertex];
+        }
+
+        const float* getNormal(unsigned int vertex) const {
+            return &vertices[(size_t)vertex * MeshImport::kFloatsPerVertex + 3];
+        }
+
+        // positions[v] is the lowest-sorted vertex at v's position; twins link the vertices at one
+        // position in a ring
+        void buildWedges(const std::vector<unsigned int>& indices) {
+            std::vector<unsigned char> referenced(vertexCount, 0);
+            for (unsigned int index : indices) {
+                referenced[index] = 1;
+            }
+
+            std::vector<unsigned int> sorted;
+            for (size_t i = 0; i < vertexCount; i++) {
+                if (referenced[i]) {
+                    sorted.push_back((unsigned int)i);
+                }
+            }
+            std::sort(sorted.begin(), sorted.end(), [this](unsigned int a, unsigned int b) {
+                const float* pa = getPosition(a);
+                const float* pb = getPosition(b);
+                return std::lexicographical_compare(pa, pa + 3, pb, pb + 3);
+            });
+
+            positions.resize(vertexCount);
+            twins.resize(vertexCount);
+            wedgeSizes.assign(vertexCount, 1);
+            for (size_t i = 0; i < vertexCount; i++) {
+                positions[i] = twins[i] = (unsigned int)i;
+            }
+
+            for (size_t begin = 0; begin < sorted.size();) {
+                size_t end = begin + 1;
+                while (end < sorted.size() && std::equal(getPosition(sorted[begin]), getPosition(sorted[begin]) + 3, getPosition(sorted[end]))) {
+                    end++;
+                }
+
+                for (size_t i = begin; i < end; i++) {
+                    positions[sorted[i]] = sorted[begin];
+                    twins[sorted[i]] = sorted[i + 1 < end ? i + 1 : begin];
+                    wedgeSizes[sorted[i]] = (unsigned int)(end - begin);
+                }
+                begin = end;
+            }
+        }
+
+        // Edges are counted between positions, so a seam is not mistaken for a border
+        void classifyVertices(const std::vector<unsigned int>& indices) {
+            std::vector<unsigned long long> edges;
+            edges.reserve(indices.size());
+            for (size_t i = 0; i < indices.size(); i += 3) {
+                for (int corner = 0; corner < 3; corner++) {
+                    edges.push_back(edgeKey(positions[indices[i + corner]], positions[indices[i + (corner + 1) % 3]]));
+                }
+            }
+            std::sort(edges.begin(), edges.end());
+
+            std::vector<unsigned char> borderPositions(vertexCount, 0);
+            std::vector<unsigned char> lockedPositions(vertexCount, 0);
+            for (size_t begin = 0; begin < edges.size();) {
+                size_t end = begin + 1;
+                while (end < edges.size() && edges[end] == edges[begin]) {
+                    end++;
+                }
+
+                unsigned int a = (unsigned int)(edges[begin] >> 32);
+                unsigned int b = (unsigned int)(edges[begin] & 0xFFFFFFFFu);
+                if (end - begin == 1) {
+                    borderEdges.push_back(edges[begin]);
+                    borderPositions[a] = borderPositions[b] = 1;
+                }
+                else if (end - begin > 2) {
+                    lockedPositions[a] = lockedPositions[b] = 1;
+                }
+                begin = end;
+            }
+
+            kinds.assign(vertexCount, Kind_Manifold);
+            for (size_t i = 0; i < vertexCount; i++) {
+                unsigned int position = positions[i];
+                if (lockedPositions[position] || wedgeSizes[i] > 2 || (wedgeSizes[i] == 2 && borderPositions[position])) {
+                    kinds[i] = Kind_Locked;
+                }
+                else if (wedgeSizes[i] == 2) {
+                    kinds[i] = Kind_Seam;
+                }
+                else if (borderPositions[position]) {
+                    kinds[i] = Kind_Border;
+                }
+            }
+        }
+
+        // Area-weighted triangle planes, plus planes standing on border edges
+        void buildQuadrics(const std::vector<unsigned int>& indices) {
+            Quadric zero = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+            quadrics.assign(vertexCount, zero);
+
+            for (size_t i = 0; i < indices.size(); i += 3) {
+                const float* p[3] = { getPosition(indices[i]), getPosition(indices[i + 1]), getPosition(indices[i + 2]) };
+                float normal[3];
+                triangleNormal(p[0], p[1], p[2], normal);
+                float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+                if (length <= 0.0f) {
+                    continue;
+                }
+                for (int axis = 0; axis < 3; axis++) {
+                    normal[axis] /= length;
+                }
+
+                double area = length * 0.5;
+                double d = -(normal[0] * p[0][0] + normal[1] * p[0][1] + normal[2] * p[0][2]);
+                for (int corner = 0; corner < 3; corner++) {
+                    Quadric& quadric = quadrics[positions[indices[i + corner]]];
+                    addPlane(quadric, normal[0], normal[1], normal[2], d, area);
+                    quadric.weight += area;
+                }
+
+                for (int corner = 0; corner < 3; corner++) {
+                    unsigned int a = positions[indices[i + corner]];
+                    unsigned int b = positions[indices[i + (corner + 1) % 3]];
+                    if (!std::binary_search(borderEdges.begin(), borderEdges.end(), edgeKey(a, b))) {
+                        continue;
+                    }
+
+                    const float* pa = p[corner];
+                    const float* pb = p[(corner + 1) % 3];
+                    float edge[3] = { pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2] };
+                    float borderNormal[3];
+                    cross(edge, normal, borderNormal);
+                    float borderLength = sqrtf(borderNormal[0] * borderNormal[0] + borderNormal[1] * borderNormal[1] + borderNormal[2] * borderNormal[2]);
+                    if (borderLength <= 0.0f) {
+                        continue;
+                    }
+                    for (int axis = 0; axis < 3; axis++) {
+                        borderNormal[axis] /= borderLength;
+                    }
+
+                    double borderD = -(borderNormal[0] * pa[0] + borderNormal[1] * pa[1] + borderNormal[2] * pa[2]);
+                    double weight = (double)borderLength * borderLength * kBorderWeight;
+                    addPlane(quadrics[a], borderNormal[0], borderNormal[1], borderNormal[2], borderD, weight);
+                    addPlane(quadrics[b], borderNormal[0], borderNormal[1], borderNormal[2], borderD, weight);
+                }
+            }
+        }
+
+        bool hasEdge(const std::vector<unsigned int>& indices, unsigned int a, unsigned int b) const {
+            for (unsigned int i = adjacency.offsets[a]; i < adjacency.offsets[a + 1]; i++) {
+                const unsigned int* triangle = &indices[(size_t)adjacency.triangles[i] * 3];
+                if (triangle[0] == b || triangle[1] == b || triangle[2] == b) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Cost of moving from onto to, in mesh units; infinite if the vertex kinds forbid it
+        float getCost(const std::vector<unsigned int>& indices, unsigned int from, unsigned int to) const {
+            const float kForbidden = 3.4e38f;
+            switch (kinds[from]) {
+            case Kind_Locked:
+                return kForbidden;
+            case Kind_Border:
+                if (!std::binary_search(borderEdges.begin(), borderEdges.end(), edgeKey(positions[from], positions[to]))) {
+                    return kForbidden;
+                }
+                break;
+            case Kind_Seam:
+                if (kinds[to] != Kind_Seam || !hasEdge(indices, twins[from], twins[to])) {
+                    return kForbidden;
+                }
+                break;
+            default:
+                break;
+            }
+
+            const Quadric& quadric = quadrics[positions[from]];
+            const float* target = getPosition(to);
+            double distanceSquared = evaluate(quadric, target) / std::max(quadric.weight, 1e-30);
+            float cost = (float)sqrt(std::max(distanceSquared, 0.0));
+
+            // Shading changes where the normals differ, even on a flat surface
+            const float* source = getPosition(from);
+            float offset[3] = { target[0] - source[0], target[1] - source[1], target[2] - source[2] };
+            float length = sqrtf(offset[0] * offset[0] + offset[1] * offset[1] + offset[2] * offset[2]);
+            float penalty = getNormalPenalty(from, to);
+            if (kinds[from] == Kind_Seam) {
+                penalty = std::max(penalty, getNormalPenalty(twins[from], twins[to]));
+            }
+            return cost + kNormalWeight * length * penalty;
+        }
+
+        // 0 for equal normals up to 2 for opposite ones; missing normals cost nothing
+        float getNormalPenalty(unsigned int a, unsigned int b) const {
+            const float* na = getNormal(a);
+            const float* nb = getNormal(b);
+            float lengths = sqrtf((na[0] * na[0] + na[1] * na[1] + na[2] * na[2]) * (nb[0] * nb[0] + nb[1] * nb[1] + nb[2] * nb[2]));
+            if (lengths <= 0.0f) {
+                return 0.0f;
+            }
+            return 1.0f - (na[0] * nb[0] + na[1] * nb[1] + na[2] * nb[2]) / lengths;
+        }
+
+        // Whether moving from onto to turns any of from's remaining triangles over
+        bool flips(const std::vector<unsigned int>& indices, unsigned int from, unsigned int to) const {
+            for (unsigned int i = adjacency.offsets[from]; i < adjacency.offsets[from + 1]; i++) {
+                const unsigned int* triangle = &indices[(size_t)adjacency.triangles[i] * 3];
+                if (triangle[0] == to || triangle[1] == to || triangle[2] == to) {
+                    continue;
+                }
+
+                const float* before[3];
+                const float* after[3];
+                for (int corner = 0; corner < 3; corner++) {
+                    before[corner] = getPosition(triangle[corner]);
+                    after[corner] = triangle[corner] == from ? getPosition(to) : before[corner];
+                }
+
+                float normalBefore[3];
+                float normalAfter[3];
+                triangleNormal(before[0], before[1], before[2], normalBefore);
+                triangleNormal(after[0], after[1], after[2], normalAfter);
+                if (normalBefore[0] * normalAfter[0] + normalBefore[1] * normalAfter[1] + normalBefore[2] * normalAfter[2] <= 0.0f) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void touchWedge(unsigned int vertex, std::vector<unsigned char>& touched) const {
+            unsigned int wedge = vertex;
+            do {
+                touched[wedge] = 1;
+                wedge = twins[wedge];
+            } while (wedge != vertex);
+        }
+
+        const std::vector<float>& vertices;
+        size_t vertexCount;
+        std::vector<unsigned int> positions;
+        std::vector<unsigned int> twins;
+        std::vector<unsigned int> wedgeSizes;
+        std::vector<unsigned char> kinds;
+        std::vector<unsigned long long> borderEdges; // Between positions, sorted
+        std::vector<Quadric> quadrics;             // Indexed by position
+        Adjacency adjacency;
+    };
+
+    float simplify(const std::vector<float>& vertices, const std::vector<unsigned int>& indices,
+        size_t targetIndexCount, float maxError, std::vector<unsigned int>& result) {
+        result = indices;
+        if (result.size() <= targetIndexCount || result.size() % 3 != 0) {
+            return 0.0f;
+        }
+
+        Simplifier simplifier(vertices, result);
+
+        float error = 0.0f;
+        while (result.size() > targetIndexCount && simplifier.collapse(result, targetIndexCount, maxError, error)) {
+        }
+        return error;
+    }
+
+    void buildLods(MeshData& mesh) {
+        MeshLod full = { 0, (unsigned int)mesh.indices.size(), 0.0f };
+        mesh.lods.assign(1, full);
+
+        // Each level is simplified from the previous one, so their errors add up
+        const float budget = mesh.bounds.sphereRadius * kMaxRelativeError;
+        std::vector<unsigned int> previous(mesh.indices);
+        std::vector<unsigned int> simplified;
+        float error = 0.0f;
+        while (mesh.lods.size() < (size_t)kMaxLods && previous.size() / 3 >= kMinTriangles) {
+            float levelError = simplify(mesh.vertices, previous, previous.size() / 6 * 3, budget - error, simplified);
+            if (simplified.empty() || (float)simplified.size() > (float)previous.size() * kMinReduction) {
+                break;
+            }
+
+            error += levelError;
+            MeshOptimization::optimizeTriangleOrder(simplified, mesh.vertices, MeshImport::kFloatsPerVertex);
+
+            MeshLod lod = { (unsigned int)mesh.indices.size(), (unsigned int)simplified.size(), error };
+            mesh.lods.push_back(lod);
+            mesh.indices.insert(mesh.indices.end(), simplified.begin(), simplified.end());
+            previous.swap(simplified);
+        }
+    }
+
+    int selectLod(const MeshLod* lods, int lodCount, int currentLod, float pixelsPerUnit) {
+        int lod = std::min(std::max(currentLod, 0), lodCount - 1);
+
+        // Finer as soon as the current level's error shows
+        while (lod > 0 && lods[lod].error * pixelsPerUnit > kMaxPixelError) {
+            lod--;
+        }
+
+        // Coarser only once the next level is well under the limit, so meshes near the threshold don't flicker
+        while (lod + 1 < lodCount && lods[lod + 1].error * pixelsPerUnit <= kMaxPixelError * kHysteresis) {
+            lod++;
+        }
+        return lod;
+    }
+}
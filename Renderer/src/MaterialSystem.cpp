@@ -0,0 +1,503 @@
+#include "../headers/MaterialSystem.h"
+
+MaterialSystem::MaterialSystem() : uploadRing(nullptr), bindless(false), frameIndex(0), droppedTextureCount(0), deferredLevelChangeCount(0),
+    materialBuffer(0), materialsDirty(true) {
+}
+
+void MaterialSystem::startup(UploadRing* ring, bool allowBindless) {
+    uploadRing = ring;
+    // The bindless shader samples through handles that differ between the sub-draws of a
+    // multi-draw, which needs NV_gpu_shader5; the array shader is safe everywhere
+    bindless = allowBindless && glfwExtensionSupported("GL_ARB_bindless_texture") && glfwExtensionSupported("GL_NV_gpu_shader5");
+
+    // BC5 and BC7 are core; BC1 still comes from the S3TC extension every desktop driver exposes
+    if (!glfwExtensionSupported("GL_EXT_texture_compression_s3tc")) {
+        OutputDebugStringA("\nGL_EXT_texture_compression_s3tc unavailable, BC1 textures will fail to upload");
+    }
+
+    glGenBuffers(1, &materialBuffer);
+    materialsDirty = true;
+}
+
+void MaterialSystem::shutdown() {
+    for (size_t i = 0; i < textures.size(); i++) {
+        if (textures[i].used) {
+            textures[i].refCount = 1;
+            releaseTexture((int)i);
+        }
+    }
+
+    // Nothing is drawn anymore, so retired copies can go right away
+    for (RetiredPlacement& retired : retiredPlacements) {
+        freePlacement(retired.placement);
+    }
+    retiredPlacements.clear();
+
+    for (TextureArray& array : arrays) {
+        if (array.texture) {
+            glDeleteTextures(1, &array.texture);
+        }
+    }
+
+    glDeleteBuffers(1, &materialBuffer);
+    materialBuffer = 0;
+
+    arrays.clear();
+    textures.clear();
+    materials.clear();
+    freeTextureIds.clear();
+    freeMaterialIds.clear();
+    sharedTextures.clear();
+}
+
+static GLenum getInternalFormat(const TextureData& texture) {
+    switch (texture.format) {
+    case TextureFormat_BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case TextureFormat_BC5: return GL_COMPRESSED_RG_RGTC2;
+    case TextureFormat_BC7: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+    case TextureFormat_RGBA8: return GL_RGBA8;
+    default: return GL_RGB8;
+    }
+}
+
+// Block formats are uploaded by internal format
+static GLenum getPixelFormat(const TextureData& texture) {
+    switch (texture.format) {
+    case TextureFormat_RGBA8: return GL_RGBA;
+    case TextureFormat_RGB8: return GL_RGB;
+    default: return getInternalFormat(texture);
+    }
+}
+
+std::vector<int> MaterialSystem::addTextures(const std::vector<TextureData>& newTextures) {
+    // Count how many layers each size/format needs, so a fresh array is created large enough for the whole model
+    typedef std::tuple<GLsizei, GLsizei, GLenum, GLsizei> ArrayKey;
+    std::map<ArrayKey, GLsizei> layersRemaining;
+    if (!bindless) {
+        for (const TextureData& texture : newTextures) {
+            if (findShared(texture) != -1) {
+                continue;
+            }
+            layersRemaining[ArrayKey(texture.width, texture.height, getInternalFormat(texture), (GLsizei)texture.mips.size())]++;
+        }
+    }
+
+    std::vector<int> textureIds;
+    for (const TextureData& texture : newTextures) {
+        int sharedId = findShared(texture);
+        if (sharedId != -1) {
+            textures[sharedId].refCount++;
+            textureIds.push_back(sharedId);
+            continue;
+        }
+
+        TextureRecord record;
+        record.used = true;
+        record.refCount = 1;
+        record.firstLevel = 0;
+
+        GLsizei layersNeeded = 1;
+        if (!bindless) {
+            GLsizei& remaining = layersRemaining[ArrayKey(texture.width, texture.height, getInternalFormat(texture), (GLsizei)texture.mips.size())];
+            layersNeeded = remaining--;
+        }
+
+        if (!place(texture, 0, layersNeeded, 0, record.placement)) {
+            OutputDebugStringA("\nOut of texture array slots, texture dropped");
+            droppedTextureCount++;
+            textureIds.push_back(-1);
+            continue;
+        }
+        record.source = texture;
+
+        int textureId;
+        if (!freeTextureIds.empty()) {
+            textureId = freeTextureIds.back();
+            freeTextureIds.pop_back();
+            textures[textureId] = std::move(record);
+        }
+        else {
+            textureId = (int)textures.size();
+            textures.push_back(std::move(record));
+        }
+        textureIds.push_back(textureId);
+
+        if (texture.contentHash != 0) {
+            sharedTextures[getContentKey(texture)] = textureId;
+        }
+    }
+
+    return textureIds;
+}
+
+MaterialSystem::ContentKey MaterialSystem::getContentKey(const TextureData& texture) {
+    return ContentKey(texture.contentHash, (int)texture.format, texture.width, texture.height, texture.mips.size());
+}
+
+int MaterialSystem::findShared(const TextureData& texture) const {
+    if (texture.contentHash == 0) {
+        return -1;
+    }
+
+    std::map<ContentKey, int>::const_iterator found = sharedTextures.find(getContentKey(texture));
+    return found != sharedTextures.end() ? found->second : -1;
+}
+
+bool MaterialSystem::releaseTexture(int textureId) {
+    if (textureId < 0 || textureId >= (int)textures.size() || !textures[textureId].used) {
+        return false;
+    }
+
+    TextureRecord& record = textures[textureId];
+    if (--record.refCount > 0) {
+        return false;
+    }
+
+    if (record.source.contentHash != 0) {
+        sharedTextures.erase(getContentKey(record.source));
+    }
+
+    // A copy still uploading for a level change goes with it
+    for (size_t i = 0; i < levelChanges.size(); i++) {
+        if (levelChanges[i].textureId == textureId) {
+            retirePlacement(levelChanges[i].placement);
+            levelChanges.erase(levelChanges.begin() + i);
+            break;
+        }
+    }
+
+    retirePlacement(record.placement);
+    record.used = false;
+    record.source = TextureData();
+    freeTextureIds.push_back(textureId);
+    return true;
+}
+
+GLuint MaterialSystem::addMaterial(int diffuseTexture, int normalTexture) {
+    MaterialRecord record;
+    record.used = true;
+    record.diffuseTexture = diffuseTexture;
+    record.normalTexture = normalTexture;
+    materialsDirty = true;
+
+    if (!freeMaterialIds.empty()) {
+        GLuint materialId = freeMaterialIds.back();
+        freeMaterialIds.pop_back();
+        materials[materialId] = record;
+        return materialId;
+    }
+
+    materials.push_back(record);
+    return (GLuint)materials.size() - 1;
+}
+
+void MaterialSystem::releaseMaterial(GLuint materialId) {
+    if (materialId >= materials.size() || !materials[materialId].used) {
+        return;
+    }
+
+    materials[materialId].used = false;
+    freeMaterialIds.push_back(materialId);
+    materialsDirty = true;
+}
+
+void MaterialSystem::getMaterialTextures(GLuint materialId, int& diffuseTexture, int& normalTexture) const {
+    diffuseTexture = -1;
+    normalTexture = -1;
+    if (materialId < materials.size() && materials[materialId].used) {
+        diffuseTexture = materials[materialId].diffuseTexture;
+        normalTexture = materials[materialId].normalTexture;
+    }
+}
+
+int MaterialSystem::getLevelCount(int textureId) const {
+    return (int)textures[textureId].source.mips.size();
+}
+
+int MaterialSystem::getArrayCount() const {
+    int count = 0;
+    for (const TextureArray& array : arrays) {
+        count += array.texture ? 1 : 0;
+    }
+    return count;
+}
+
+int MaterialSystem::getLargestDimension(int textureId) const {
+    const TextureData& source = textures[textureId].source;
+    return source.width > source.height ? source.width : source.height;
+}
+
+int MaterialSystem::getFirstLevel(int textureId) const {
+    for (const LevelChange& change : levelChanges) {
+        if (change.textureId == textureId) {
+            return change.firstLevel;
+        }
+    }
+    return textures[textureId].firstLevel;
+}
+
+bool MaterialSystem::isLevelChangePending(int textureId) const {
+    for (const LevelChange& change : levelChanges) {
+        if (change.textureId == textureId) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t MaterialSystem::getTextureBytes(int textureId, int firstLevel) const {
+    const TextureData& source = textures[textureId].source;
+    size_t bytes = 0;
+    for (size_t level = firstLevel; level < source.mips.size(); level++) {
+        bytes += source.mips[level].size();
+    }
+    return bytes;
+}
+
+bool MaterialSystem::requestFirstLevel(int textureId, int firstLevel) {
+    if (textureId < 0 || textureId >= (int)textures.size() || !textures[textureId].used
+        || firstLevel < 0 || firstLevel >= getLevelCount(textureId)
+        || firstLevel == textures[textureId].firstLevel || isLevelChangePending(textureId)) {
+        return false;
+    }
+
+    // Every texture of the same shape can end up at this level, so a new array is sized for all
+    // of them rather than for this one
+    const TextureData& source = textures[textureId].source;
+    GLsizei sameShape = 0;
+    for (const TextureRecord& record : textures) {
+        sameShape += record.used && record.source.width == source.width && record.source.height == source.height
+            && record.source.format == source.format && record.source.mips.size() == source.mips.size() ? 1 : 0;
+    }
+
+    LevelChange change;
+    change.textureId = textureId;
+    change.firstLevel = firstLevel;
+    if (!place(source, firstLevel, sameShape, kReservedArraySlots, change.placement)) {
+        deferredLevelChangeCount++;
+        return false;
+    }
+
+    levelChanges.push_back(change);
+    return true;
+}
+
+void MaterialSystem::update() {
+    frameIndex++;
+
+    for (size_t i = 0; i < levelChanges.size();) {
+        const LevelChange& change = levelChanges[i];
+        if (!uploadRing->isSubmitted(change.placement.ticket)) {
+            i++;
+            continue;
+        }
+
+        TextureRecord& record = textures[change.textureId];
+        retirePlacement(record.placement);
+        record.placement = change.placement;
+        record.firstLevel = change.firstLevel;
+        materialsDirty = true;
+        levelChanges.erase(levelChanges.begin() + i);
+    }
+
+    // A copy whose uploads are still queued can't be deleted yet: GL could hand its name to a new
+    // texture before the stale copies into it run
+    size_t kept = 0;
+    for (size_t i = 0; i < retiredPlacements.size(); i++) {
+        const RetiredPlacement& retired = retiredPlacements[i];
+        if (retired.frame + kRetireFrames <= frameIndex && uploadRing->isSubmitted(retired.placement.ticket)) {
+            freePlacement(retired.placement);
+        }
+        else {
+            retiredPlacements[kept++] = retired;
+        }
+    }
+    retiredPlacements.resize(kept);
+}
+
+int MaterialSystem::bind(GLint textureArraysLocation) {
+    if (materialsDirty) {
+        updateMaterialBuffer();
+    }
+
+    if (!bindless) {
+        GLint units[kMaxTextureArrays];
+        for (int i = 0; i < kMaxTextureArrays; i++) {
+            units[i] = i;
+        }
+        glUniform1iv(textureArraysLocation, kMaxTextureArrays, units);
+
+        for (size_t i = 0; i < arrays.size(); i++) {
+            glActiveTexture(GL_TEXTURE0 + (GLenum)i);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, arrays[i].texture);
+        }
+    }
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kMaterialBufferBinding, materialBuffer);
+    return bindless ? 1 : (int)arrays.size() + 1;
+}
+
+// A new array is only created while reservedSlots slots would stay free after it
+int MaterialSystem::findArray(GLsizei width, GLsizei height, GLenum internalFormat, GLsizei levels, GLsizei layersNeeded, int reservedSlots) {
+    int emptySlot = -1;
+    int liveArrays = 0;
+    for (size_t i = 0; i < arrays.size(); i++) {
+        const TextureArray& array = arrays[i];
+        if (!array.texture) {
+            emptySlot = emptySlot == -1 ? (int)i : emptySlot;
+            continue;
+        }
+
+        liveArrays++;
+        if (array.width == width && array.height == height && array.internalFormat == internalFormat
+            && array.levels == levels && !array.freeLayers.empty()) {
+            return (int)i;
+        }
+    }
+
+    if (liveArrays + reservedSlots >= kMaxTextureArrays) {
+        return -1;
+    }
+
+    // Layers can't be added to immutable storage, so round up to leave room for later loads
+    GLsizei capacity = 4;
+    while (capacity < layersNeeded) {
+        capacity *= 2;
+    }
+
+    TextureArray array;
+    array.width = width;
+    array.height = height;
+    array.levels = levels;
+    array.internalFormat = internalFormat;
+    array.capacity = capacity;
+    for (GLint layer = capacity - 1; layer >= 0; layer--) {
+        array.freeLayers.push_back(layer);
+    }
+
+    glGenTextures(1, &array.texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, internalFormat, width, height, capacity);
+
+    if (emptySlot != -1) {
+        arrays[emptySlot] = array;
+        return emptySlot;
+    }
+
+    arrays.push_back(array);
+    return (int)arrays.size() - 1;
+}
+
+static GLsizei getLevelSize(int size, int level) {
+    size >>= level;
+    return size > 1 ? size : 1;
+}
+
+bool MaterialSystem::place(const TextureData& texture, int firstLevel, GLsizei layersNeeded, int reservedSlots, Placement& placement) {
+    placement.array = -1;
+    placement.layer = -1;
+    placement.texture = 0;
+    placement.handle = 0;
+    placement.ticket = 0;
+
+    if (bindless) {
+        placeBindless(texture, firstLevel, placement);
+        return true;
+    }
+
+    placement.array = findArray(getLevelSize(texture.width, firstLevel), getLevelSize(texture.height, firstLevel),
+        getInternalFormat(texture), (GLsizei)texture.mips.size() - firstLevel, layersNeeded, reservedSlots);
+    if (placement.array == -1) {
+        return false;
+    }
+
+    placeInArray(texture, firstLevel, placement);
+    return true;
+}
+
+void MaterialSystem::placeInArray(const TextureData& texture, int firstLevel, Placement& placement) {
+    TextureArray& array = arrays[placement.array];
+    placement.layer = array.freeLayers.back();
+    array.freeLayers.pop_back();
+
+    placement.ticket = uploadMips(texture, firstLevel, array.texture, GL_TEXTURE_2D_ARRAY, placement.layer);
+}
+
+void MaterialSystem::placeBindless(const TextureData& texture, int firstLevel, Placement& placement) {
+    glGenTextures(1, &placement.texture);
+    glBindTexture(GL_TEXTURE_2D, placement.texture);
+    glTexStorage2D(GL_TEXTURE_2D, (GLsizei)texture.mips.size() - firstLevel, getInternalFormat(texture),
+        getLevelSize(texture.width, firstLevel), getLevelSize(texture.height, firstLevel));
+
+    placement.ticket = uploadMips(texture, firstLevel, placement.texture, GL_TEXTURE_2D, 0);
+
+    // Sampler state is baked into the handle, so it must be final before this point
+    placement.handle = glGetTextureHandleARB(placement.texture);
+    glMakeTextureHandleResidentARB(placement.handle);
+}
+
+UploadRing::Ticket MaterialSystem::uploadMips(const TextureData& texture, int firstLevel, GLuint target, GLenum textureType, GLint layer) {
+    UploadRing::Ticket ticket = 0;
+    for (size_t level = firstLevel; level < texture.mips.size(); level++) {
+        ticket = uploadRing->queueTexture(target, textureType, (GLint)(level - firstLevel), layer,
+            getLevelSize(texture.width, (int)level), getLevelSize(texture.height, (int)level), getPixelFormat(texture),
+            texture.mips[level].data(), texture.mips[level].size());
+    }
+    return ticket;
+}
+
+void MaterialSystem::freePlacement(const Placement& placement) {
+    if (bindless) {
+        glMakeTextureHandleNonResidentARB(placement.handle);
+        glDeleteTextures(1, &placement.texture);
+        return;
+    }
+
+    // Arrays only give their memory back once they are empty
+    TextureArray& array = arrays[placement.array];
+    array.freeLayers.push_back(placement.layer);
+    if ((GLsizei)array.freeLayers.size() == array.capacity) {
+        glDeleteTextures(1, &array.texture);
+        array.texture = 0;
+        array.freeLayers.clear();
+    }
+}
+
+// Frames already submitted may still sample the copy, so it is freed kRetireFrames updates later,
+// and not before its own uploads have been submitted
+void MaterialSystem::retirePlacement(const Placement& placement) {
+    RetiredPlacement retired;
+    retired.placement = placement;
+    retired.frame = frameIndex;
+    retiredPlacements.push_back(retired);
+}
+
+void MaterialSystem::updateMaterialBuffer() {
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, materialBuffer);
+
+    if (bindless) {
+        std::vector<BindlessMaterialEntry> entries(materials.size());
+        for (size_t i = 0; i < materials.size(); i++) {
+            int diffuse = materials[i].used ? materials[i].diffuseTexture : -1;
+            int normal = materials[i].used ? materials[i].normalTexture : -1;
+            entries[i].diffuseHandle = diffuse >= 0 ? textures[diffuse].placement.handle : 0;
+            entries[i].normalHandle = normal >= 0 ? textures[normal].placement.handle : 0;
+        }
+        glBufferData(GL_SHADER_STORAGE_BUFFER, entries.size() * sizeof(BindlessMaterialEntry), entries.data(), GL_STATIC_DRAW);
+    }
+    else {
+        std::vector<ArrayMaterialEntry> entries(materials.size());
+        for (size_t i = 0; i < materials.size(); i++) {
+            int diffuse = materials[i].used ? materials[i].diffuseTexture : -1;
+            int normal = materials[i].used ? materials[i].normalTexture : -1;
+            entries[i].diffuseArray = diffuse >= 0 ? textures[diffuse].placement.array : -1;
+            entries[i].diffuseLayer = diffuse >= 0 ? textures[diffuse].placement.layer : 0;
+            entries[i].normalArray = normal >= 0 ? textures[normal].placement.array : -1;
+            entries[i].normalLayer = normal >= 0 ? textures[normal].placement.layer : 0;
+        }
+        glBufferData(GL_SHADER_STORAGE_BUFFER, entries.size() * sizeof(ArrayMaterialEntry), entries.data(), GL_STATIC_DRAW);
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    materialsDirty = false;
+}
@@ -0,0 +1,408 @@
+#include "../headers/MeshCache.h"
+#include "../headers/MeshImport.h"
+#include "../headers/TextureCompression.h"
+#include "SharedUtilities.h"
+#include <string.h>
+
+namespace MeshCache {
+    static const char kMagic[4] = { 'E', 'S', 'M', 'C' };
+    static const int kMaxTextureSize = 16384;
+
+    // Levels down to 1x1: floor(log2(max(width, height))) + 1
+    static int getFullMipCount(int width, int height) {
+        int largest = width > height ? width : height;
+        int count = 1;
+        while (largest > 1) {
+            largest >>= 1;
+            count++;
+        }
+        return count;
+    }
+
+    struct FileHeader {
+        char magic[4];
+        unsigned int version;
+        unsigned long long sourceHash;
+        unsigned long long sourceSize;
+        unsigned int importFlags;
+        unsigned int textureCount;
+        unsigned int meshCount;
+        unsigned int nodeCount;
+    };
+
+    // Read-only view of a whole file, unmapped on destruction
+    class MappedFile {
+    public:
+        MappedFile(const std::string& path) : file(INVALID_HANDLE_VALUE), mapping(NULL), data(nullptr), size(0) {
+            file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+            if (file == INVALID_HANDLE_VALUE) {
+                return;
+            }
+
+            LARGE_INTEGER fileSize;
+            if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+                return;
+            }
+
+            mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (mapping == NULL) {
+                return;
+            }
+
+            data = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+            if (data) {
+                size = (size_t)fileSize.QuadPart;
+            }
+        }
+
+        ~MappedFile() {
+            if (data) UnmapViewOfFile(data);
+            if (mapping) CloseHandle(mapping);
+            if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        }
+
+        const unsigned char* getData() const { return data; }
+        size_t getSize() const { return size; }
+
+    private:
+        MappedFile(const MappedFile&);
+        MappedFile& operator=(const MappedFile&);
+
+        HANDLE file;
+        HANDLE mapping;
+        const unsigned char* data;
+        size_t size;
+    };
+
+    // Bounds-checked cursor over the mapped cache; any overrun marks the whole read as failed
+    struct Reader {
+        const unsigned char* cursor;
+        const unsigned char* end;
+        bool ok;
+
+        bool read(void* out, size_t bytes) {
+            if (!ok || (size_t)(end - cursor) < bytes) {
+                ok = false;
+                return false;
+            }
+            memcpy(out, cursor, bytes);
+            cursor += bytes;
+            return true;
+        }
+
+        template <typename T>
+        bool read(T& value) {
+            return read(&value, sizeof(T));
+        }
+    };
+
+    static void write(FILE* fp, const void* data, size_t bytes) {
+        if (bytes > 0) {
+            fwrite(data, 1, bytes, fp);
+        }
+    }
+
+    template <typename T>
+    static void write(FILE* fp, const T& value) {
+        write(fp, &value, sizeof(T));
+    }
+
+    // Fast enough to run on every launch
+    unsigned long long hashBytes(const unsigned char* data, size_t size) {
+        const unsigned long long prime = 1099511628211ull;
+        unsigned long long hash = 14695981039346656037ull;
+
+        size_t wordCount = size / sizeof(unsigned long long);
+        for (size_t i = 0; i < wordCount; i++) {
+            unsigned long long word;
+            memcpy(&word, data + i * sizeof(unsigned long long), sizeof(word));
+            hash = (hash ^ word) * prime;
+        }
+
+        for (size_t i = wordCount * sizeof(unsigned long long); i < size; i++) {
+            hash = (hash ^ data[i]) * prime;
+        }
+
+        return hash;
+    }
+
+    std::string getCachePath(const std::string& sourcePath) {
+        return sourcePath + ".meshcache";
+    }
+
+    bool computeKey(const std::string& sourcePath, unsigned int importFlags, Key& key) {
+        MappedFile source(sourcePath);
+        if (!source.getData()) {
+            return false;
+        }
+
+        key.sourceHash = hashBytes(source.getData(), source.getSize());
+        key.sourceSize = source.getSize();
+        key.importFlags = importFlags;
+        return true;
+    }
+
+    bool load(const std::string& cachePath, const Key& key, ModelData& modelData) {
+        MappedFile cache(cachePath);
+        if (!cache.getData()) {
+            return false;
+        }
+
+        Reader reader = { cache.getData(), cache.getData() + cache.getSize(), true };
+
+        FileHeader header;
+        if (!reader.read(header)
+            || memcmp(header.magic, kMagic, sizeof(kMagic)) != 0
+            || header.version != kVersion
+            || header.sourceHash != key.sourceHash
+            || header.sourceSize != key.sourceSize
+            || header.importFlags != key.importFlags
+            || (unsigned long long)header.textureCount + header.meshCount + header.nodeCount > cache.getSize()) {
+            return false;
+        }
+
+        ModelData result;
+        result.nodes.resize(header.nodeCount);
+        for (size_t i = 0; i < result.nodes.size(); i++) {
+            NodeData& node = result.nodes[i];
+            reader.read(node.parent);
+            reader.read(&node.translation[0], sizeof(float) * 3);
+            reader.read(&node.rotation[0], sizeof(float) * 4);
+            reader.read(&node.scale[0], sizeof(float) * 3);
+            if (!reader.ok || node.parent < -1 || node.parent >= (int)i) {
+                return false;
+            }
+        }
+
+        result.textures.resize(header.textureCount);
+        for (TextureData& texture : result.textures) {
+            int mipCount = 0;
+            int format = 0;
+            reader.read(texture.width);
+            reader.read(texture.height);
+            reader.read(texture.channels);
+            reader.read(texture.contentHash);
+            reader.read(format);
+            reader.read(mipCount);
+            if (!reader.ok || texture.width <= 0 || texture.height <= 0 || texture.width > kMaxTextureSize || texture.height > kMaxTextureSize
+                || mipCount <= 0 || mipCount > getFullMipCount(texture.width, texture.height) || format < 0 || format >= TextureFormat_Count) {
+                return false;
+            }
+            texture.format = (TextureFormat)format;
+
+            // Every level must be exactly the size the upload will read, as Ktx2::load checks
+            texture.mips.resize(mipCount);
+            for (int level = 0; level < mipCount; level++) {
+                std::vector<unsigned char>& mip = texture.mips[level];
+                int width = texture.width >> level;
+                int height = texture.height >> level;
+                unsigned long long byteCount = 0;
+                if (!reader.read(byteCount) || byteCount > (unsigned long long)(reader.end - reader.cursor)
+                    || byteCount != TextureCompression::getLevelBytes(texture.format, width > 1 ? width : 1, height > 1 ? height : 1)) {
+                    return false;
+                }
+                mip.resize((size_t)byteCount);
+                reader.read(mip.data(), mip.size());
+            }
+        }
+
+        result.meshes.resize(header.meshCount);
+        for (MeshData& mesh : result.meshes) {
+            unsigned int floatCount = 0;
+            unsigned int indexCount = 0;
+            unsigned int indexSize = 0;
+            reader.read(mesh.node);
+            reader.read(mesh.diffuseTexture);
+            reader.read(mesh.normalTexture);
+            reader.read(&mesh.bounds.aabbMin[0], sizeof(float) * 3);
+            reader.read(&mesh.bounds.aabbMax[0], sizeof(float) * 3);
+            reader.read(&mesh.bounds.sphereCenter[0], sizeof(float) * 3);
+            reader.read(mesh.bounds.sphereRadius);
+            reader.read(floatCount);
+            reader.read(indexCount);
+            reader.read(indexSize);
+            if (!reader.ok || (indexSize != 2 && indexSize != 4) || floatCount % MeshImport::kFloatsPerVertex != 0
+                || (unsigned long long)floatCount * sizeof(float) + (unsigned long long)indexCount * indexSize > (unsigned long long)(reader.end - reader.cursor)) {
+                return false;
+            }
+
+            mesh.vertices.resize(floatCount);
+            reader.read(mesh.vertices.data(), floatCount * sizeof(float));
+
+            mesh.indices.resize(indexCount);
+            if (indexSize == 4) {
+                reader.read(mesh.indices.data(), indexCount * sizeof(unsigned int));
+            }
+            else {
+                // Widen 16-bit indices stored for small meshes
+                const unsigned char* src = reader.cursor;
+                for (unsigned int i = 0; i < indexCount; i++) {
+                    unsigned short index;
+                    memcpy(&index, src + i * sizeof(unsigned short), sizeof(index));
+                    mesh.indices[i] = index;
+                }
+                reader.cursor += indexCount * sizeof(unsigned short);
+            }
+
+            // Everything downstream indexes the vertices without checking
+            const unsigned int vertexCount = floatCount / MeshImport::kFloatsPerVertex;
+            for (unsigned int index : mesh.indices) {
+                if (index >= vertexCount) {
+                    return false;
+                }
+            }
+
+            unsigned int lodCount = 0;
+            if (!reader.read(lodCount) || lodCount == 0 || lodCount > (unsigned int)kMaxLods) {
+                return false;
+            }
+            mesh.lods.resize(lodCount);
+            for (MeshLod& lod : mesh.lods) {
+                reader.read(lod.firstIndex);
+                reader.read(lod.indexCount);
+                reader.read(lod.error);
+                if ((unsigned long long)lod.firstIndex + lod.indexCount > indexCount) {
+                    return false;
+                }
+            }
+
+            unsigned int meshletCount = 0;
+            if (!reader.read(meshletCount) || meshletCount > indexCount / 3) {
+                return false;
+            }
+            mesh.meshlets.resize(meshletCount);
+            for (Meshlet& meshlet : mesh.meshlets) {
+                reader.read(meshlet.firstIndex);
+                reader.read(meshlet.indexCount);
+                reader.read(&meshlet.center[0], sizeof(float) * 3);
+                reader.read(meshlet.radius);
+                reader.read(&meshlet.coneAxis[0], sizeof(float) * 3);
+                reader.read(meshlet.coneCutoff);
+                if ((unsigned long long)meshlet.firstIndex + meshlet.indexCount > indexCount) {
+                    return false;
+                }
+            }
+
+            if (mesh.node < 0 || mesh.node >= (int)header.nodeCount
+                || mesh.diffuseTexture < -1 || mesh.diffuseTexture >= (int)header.textureCount
+                || mesh.normalTexture < -1 || mesh.normalTexture >= (int)header.textureCount) {
+                return false;
+            }
+        }
+
+        if (!reader.ok) {
+            return false;
+        }
+
+        modelData = std::move(result);
+        return true;
+    }
+
+    bool save(const std::string& cachePath, const Key& key, const ModelData& modelData) {
+        // Write to a temporary file and swap it in, so an interrupted save never leaves a truncated cache.
+        // The name is unique per thread, so concurrent saves of the same model never share a file.
+        char tempSuffix[32];
+        snprintf(tempSuffix, sizeof(tempSuffix), ".%lu.%lu.tmp", (unsigned long)GetCurrentProcessId(), (unsigned long)GetCurrentThreadId());
+        std::string tempPath = cachePath + tempSuffix;
+        FILE* fp = fopen(tempPath.c_str(), "wb");
+        if (!fp) {
+            OutputDebugStringA("\nFailed to open mesh cache for writing");
+            return false;
+        }
+
+        FileHeader header;
+        memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version = kVersion;
+        header.sourceHash = key.sourceHash;
+        header.sourceSize = key.sourceSize;
+        header.importFlags = key.importFlags;
+        header.textureCount = (unsigned int)modelData.textures.size();
+        header.meshCount = (unsigned int)modelData.meshes.size();
+        header.nodeCount = (unsigned int)modelData.nodes.size();
+        write(fp, header);
+
+        for (const NodeData& node : modelData.nodes) {
+            write(fp, node.parent);
+            write(fp, &node.translation[0], sizeof(float) * 3);
+            write(fp, &node.rotation[0], sizeof(float) * 4);
+            write(fp, &node.scale[0], sizeof(float) * 3);
+        }
+
+        for (const TextureData& texture : modelData.textures) {
+            int mipCount = (int)texture.mips.size();
+            int format = (int)texture.format;
+            write(fp, texture.width);
+            write(fp, texture.height);
+            write(fp, texture.channels);
+            write(fp, texture.contentHash);
+            write(fp, format);
+            write(fp, mipCount);
+            for (const std::vector<unsigned char>& mip : texture.mips) {
+                unsigned long long byteCount = mip.size();
+                write(fp, byteCount);
+                write(fp, mip.data(), mip.size());
+            }
+        }
+
+        for (const MeshData& mesh : modelData.meshes) {
+            unsigned int floatCount = (unsigned int)mesh.vertices.size();
+            unsigned int indexCount = (unsigned int)mesh.indices.size();
+            bool shortIndices = floatCount / MeshImport::kFloatsPerVertex <= 65536;
+            unsigned int indexSize = shortIndices ? 2 : 4;
+
+            write(fp, mesh.node);
+            write(fp, mesh.diffuseTexture);
+            write(fp, mesh.normalTexture);
+            write(fp, &mesh.bounds.aabbMin[0], sizeof(float) * 3);
+            write(fp, &mesh.bounds.aabbMax[0], sizeof(float) * 3);
+            write(fp, &mesh.bounds.sphereCenter[0], sizeof(float) * 3);
+            write(fp, mesh.bounds.sphereRadius);
+            write(fp, floatCount);
+            write(fp, indexCount);
+            write(fp, indexSize);
+            write(fp, mesh.vertices.data(), floatCount * sizeof(float));
+
+            if (shortIndices) {
+                std::vector<unsigned short> narrowed(mesh.indices.begin(), mesh.indices.end());
+                write(fp, narrowed.data(), narrowed.size() * sizeof(unsigned short));
+            }
+            else {
+                write(fp, mesh.indices.data(), indexCount * sizeof(unsigned int));
+            }
+
+            unsigned int lodCount = (unsigned int)mesh.lods.size();
+            write(fp, lodCount);
+            for (const MeshLod& lod : mesh.lods) {
+                write(fp, lod.firstIndex);
+                write(fp, lod.indexCount);
+                write(fp, lod.error);
+            }
+
+            unsigned int meshletCount = (unsigned int)mesh.meshlets.size();
+            write(fp, meshletCount);
+            for (const Meshlet& meshlet : mesh.meshlets) {
+                write(fp, meshlet.firstIndex);
+                write(fp, meshlet.indexCount);
+                write(fp, &meshlet.center[0], sizeof(float) * 3);
+                write(fp, meshlet.radius);
+                write(fp, &meshlet.coneAxis[0], sizeof(float) * 3);
+                write(fp, meshlet.coneCutoff);
+            }
+        }
+
+        bool ok = ferror(fp) == 0;
+        ok &= fclose(fp) == 0;
+
+        // Replaces in one step, so a concurrent load sees either the old cache or the new one
+        if (ok) {
+            ok = MoveFileExA(tempPath.c_str(), cachePath.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+        }
+
+        if (!ok) {
+            remove(tempPath.c_str());
+            OutputDebugStringA("\nFailed to write mesh cache");
+        }
+
+        return ok;
+    }
+}
@@ -0,0 +1,224 @@
+#include "../headers/MeshImport.h"
+#include "../headers/Ktx2.h"
+#include "stb_image.h"
+
+namespace MeshImport {
+    // One specialization per attribute combination, so the inner loop has no per-vertex branches
+    template <bool hasNormals, bool hasTangents, bool hasTexCoords>
+    static void fillKernel(const aiMesh* mesh, float* out) {
+        const aiVector3D* positions = mesh->mVertices;
+        const aiVector3D* normals = mesh->mNormals;
+        const aiVector3D* tangents = mesh->mTangents;
+        const aiVector3D* texCoords = mesh->mTextureCoords[0];
+        const unsigned int vertexCount = mesh->mNumVertices;
+
+        for (unsigned int i = 0; i < vertexCount; i++) {
+            float* v = out + i * kFloatsPerVertex;
+
+            v[0] = positions[i].x;
+            v[1] = positions[i].y;
+            v[2] = positions[i].z;
+
+            v[3] = hasNormals ? normals[i].x : 0.0f;
+            v[4] = hasNormals ? normals[i].y : 0.0f;
+            v[5] = hasNormals ? normals[i].z : 0.0f;
+
+            v[6] = hasTangents ? tangents[i].x : 0.0f;
+            v[7] = hasTangents ? tangents[i].y : 0.0f;
+            v[8] = hasTangents ? tangents[i].z : 0.0f;
+
+            v[9] = hasTexCoords ? texCoords[i].x : 0.0f;
+            v[10] = hasTexCoords ? texCoords[i].y : 0.0f;
+        }
+    }
+
+    // Indexed by AttributeFlags
+    static const FillVerticesKernel fillKernels[Attribute_Count] = {
+        fillKernel<false, false, false>,
+        fillKernel<true, false, false>,
+        fillKernel<false, true, false>,
+        fillKernel<true, true, false>,
+        fillKernel<false, false, true>,
+        fillKernel<true, false, true>,
+        fillKernel<false, true, true>,
+        fillKernel<true, true, true>,
+    };
+
+    unsigned int getAttributeFlags(const aiMesh* mesh) {
+        unsigned int flags = 0;
+        if (mesh->HasNormals()) flags |= Attribute_Normals;
+        if (mesh->HasTangentsAndBitangents()) flags |= Attribute_Tangents;
+        if (mesh->mTextureCoords[0]) flags |= Attribute_TexCoords;
+        return flags;
+    }
+
+    FillVerticesKernel selectFillKernel(unsigned int attributeFlags) {
+        return fillKernels[attributeFlags & (Attribute_Count - 1)];
+    }
+
+    void fillVertices(const aiMesh* mesh, std::vector<float>& vertices) {
+        vertices.resize((size_t)mesh->mNumVertices * kFloatsPerVertex);
+        if (mesh->mNumVertices == 0) {
+            return;
+        }
+
+        FillVerticesKernel kernel = selectFillKernel(getAttributeFlags(mesh));
+        kernel(mesh, vertices.data());
+    }
+
+    void fillIndices(const aiMesh* mesh, std::vector<unsigned int>& indices) {
+        // After aiProcess_Triangulate most meshes are triangle-only, so the size is known up front
+        if (mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE) {
+            indices.resize((size_t)mesh->mNumFaces * 3);
+            unsigned int* out = indices.data();
+            for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
+                const unsigned int* faceIndices = mesh->mFaces[i].mIndices;
+                out[i * 3 + 0] = faceIndices[0];
+                out[i * 3 + 1] = faceIndices[1];
+                out[i * 3 + 2] = faceIndices[2];
+            }
+            return;
+        }
+
+        // Mixed primitive types: count first, then copy
+        size_t indexCount = 0;
+        for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
+            indexCount += mesh->mFaces[i].mNumIndices;
+        }
+
+        indices.resize(indexCount);
+        size_t offset = 0;
+        for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
+            const aiFace& face = mesh->mFaces[i];
+            for (unsigned int j = 0; j < face.mNumIndices; j++) {
+                indices[offset++] = face.mIndices[j];
+            }
+        }
+    }
+
+    void splitMesh(const MeshData& mesh, unsigned int maxVertices, std::vector<MeshData>& parts) {
+        const size_t vertexCount = mesh.vertices.size() / kFloatsPerVertex;
+        std::vector<unsigned int> remap(vertexCount, ~0u); // Source vertex to index in the current part
+        std::vector<unsigned int> used; // Source vertices of the current part, to reset remap
+
+        parts.clear();
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+            unsigned int newVertices = 0;
+            for (int corner = 0; corner < 3; corner++) {
+                newVertices += remap[mesh.indices[i + corner]] == ~0u ? 1 : 0;
+            }
+
+            // Start a new part when the triangle would not fit
+            if (parts.empty() || used.size() + newVertices > maxVertices) {
+                if (!parts.empty()) {
+                    parts.back().bounds = computeBounds(parts.back().vertices, kFloatsPerVertex);
+                }
+                for (unsigned int vertex : used) {
+                    remap[vertex] = ~0u;
+                }
+                used.clear();
+
+                parts.push_back(MeshData());
+                parts.back().diffuseTexture = mesh.diffuseTexture;
+                parts.back().normalTexture = mesh.normalTexture;
+                parts.back().node = mesh.node;
+            }
+
+            MeshData& part = parts.back();
+            for (int corner = 0; corner < 3; corner++) {
+                unsigned int vertex = mesh.indices[i + corner];
+                if (remap[vertex] == ~0u) {
+                    remap[vertex] = (unsigned int)used.size();
+                    used.push_back(vertex);
+                    const float* source = &mesh.vertices[(size_t)vertex * kFloatsPerVertex];
+                    part.vertices.insert(part.vertices.end(), source, source + kFloatsPerVertex);
+                }
+                part.indices.push_back(remap[vertex]);
+            }
+        }
+
+        if (!parts.empty()) {
+            parts.back().bounds = computeBounds(parts.back().vertices, kFloatsPerVertex);
+        }
+    }
+
+    void fillVerticesReference(const aiMesh* mesh, std::vector<float>& vertices) {
+        for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
+
+            // Vertex positions
+            vertices.push_back(mesh->mVertices[i].x);
+            vertices.push_back(mesh->mVertices[i].y);
+            vertices.push_back(mesh->mVertices[i].z);
+
+            // Normals
+            if (mesh->HasNormals()) {
+                vertices.push_back(mesh->mNormals[i].x);
+                vertices.push_back(mesh->mNormals[i].y);
+                vertices.push_back(mesh->mNormals[i].z);
+            }
+            else {
+                vertices.push_back(0.0f);
+                vertices.push_back(0.0f);
+                vertices.push_back(0.0f);
+            }
+
+            // Tangents
+            if (mesh->HasTangentsAndBitangents()) {
+                vertices.push_back(mesh->mTangents[i].x);
+                vertices.push_back(mesh->mTangents[i].y);
+                vertices.push_back(mesh->mTangents[i].z);
+            }
+            else {
+                vertices.push_back(0.0f);
+                vertices.push_back(0.0f);
+                vertices.push_back(0.0f);
+            }
+
+            // Texture coordinates
+            if (mesh->mTextureCoords[0]) {
+                vertices.push_back(mesh->mTextureCoords[0][i].x);
+                vertices.push_back(mesh->mTextureCoords[0][i].y);
+            }
+            else {
+                vertices.push_back(0.0f);
+                vertices.push_back(0.0f);
+            }
+        }
+    }
+
+    bool decodeTexture(const aiTexture* texture, TextureData& textureData) {
+        // mHeight == 0 marks a compressed image of mWidth bytes
+        if (texture->mHeight != 0) {
+            return false;
+        }
+
+        const unsigned char* data = reinterpret_cast<const unsigned char*>(texture->pcData);
+        if (Ktx2::isKtx2(data, texture->mWidth)) {
+            return Ktx2::load(data, texture->mWidth, textureData);
+        }
+
+        int width, height, nrChannels;
+
+        // Keep RGB as-is, expand everything else to RGBA
+        if (!stbi_info_from_memory(data, texture->mWidth, &width, &height, &nrChannels)) {
+            nrChannels = 4;
+        }
+        int desiredChannels = nrChannels == 3 ? 3 : 4;
+
+        unsigned char* imageData = stbi_load_from_memory(data, texture->mWidth, &width, &height, &nrChannels, desiredChannels);
+        if (!imageData) {
+            return false;
+        }
+
+        textureData.width = width;
+        textureData.height = height;
+        textureData.channels = desiredChannels;
+        textureData.format = desiredChannels == 3 ? TextureFormat_RGB8 : TextureFormat_RGBA8;
+        textureData.mips.resize(1);
+        textureData.mips[0].assign(imageData, imageData + (size_t)width * height * desiredChannels);
+        buildMipChain(textureData);
+
+        stbi_image_free(imageData);
+        return true;
+    }
+}
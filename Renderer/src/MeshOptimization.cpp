@@ -0,0 +1,292 @@
+#include "../headers/MeshOptimization.h"
+#include <algorithm>
+#include <math.h>
+
+namespace MeshOptimization {
+    // A cluster ends once its own ACMR is within this factor of the whole mesh's. Lower values give
+    // fewer, longer clusters and keep more of the cache gain; higher values sort more finely.
+    static const float kClusterThreshold = 1.05f;
+
+    // Triangles around each vertex, as ranges of one shared list
+    struct Adjacency {
+        std::vector<unsigned int> offsets;
+        std::vector<unsigned int> triangles;
+    };
+
+    static void buildAdjacency(const std::vector<unsigned int>& indices, size_t vertexCount, Adjacency& adjacency) {
+        adjacency.offsets.assign(vertexCount + 1, 0);
+        for (unsigned int index : indices) {
+            adjacency.offsets[index + 1]++;
+        }
+        for (size_t i = 0; i < vertexCount; i++) {
+            adjacency.offsets[i + 1] += adjacency.offsets[i];
+        }
+
+        std::vector<unsigned int> cursors(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+        adjacency.triangles.resize(indices.size());
+        for (size_t i = 0; i < indices.size(); i++) {
+            adjacency.triangles[cursors[indices[i]]++] = (unsigned int)(i / 3);
+        }
+    }
+
+    CacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount) {
+        CacheStats stats = { 0.0f, 0.0f };
+        if (indices.size() < 3 || vertexCount == 0) {
+            return stats;
+        }
+
+        // A vertex is cached while fewer than kCacheSize others were added after it
+        std::vector<unsigned int> timestamps(vertexCount, 0);
+        unsigned int time = kCacheSize + 1;
+        size_t misses = 0;
+        for (unsigned int index : indices) {
+            if (time - timestamps[index] > kCacheSize) {
+                timestamps[index] = time++;
+                misses++;
+            }
+        }
+
+        stats.acmr = (float)misses / (float)(indices.size() / 3);
+        stats.atvr = (float)misses / (float)vertexCount;
+        return stats;
+    }
+
+    // Most recently used vertex that still has triangles left, else the next one in index order
+    static int skipDeadEnd(const std::vector<unsigned int>& liveTriangles, std::vector<unsigned int>& deadEnds, size_t& cursor) {
+        while (!deadEnds.empty()) {
+            unsigned int vertex = deadEnds.back();
+            deadEnds.pop_back();
+            if (liveTriangles[vertex] > 0) {
+                return (int)vertex;
+            }
+        }
+
+        for (; cursor < liveTriangles.size(); cursor++) {
+            if (liveTriangles[cursor] > 0) {
+                return (int)cursor;
+            }
+        }
+        return -1;
+    }
+
+    // Tipsify: emits every remaining triangle around one vertex, then moves to the vertex of those
+    // triangles that is oldest in the cache but will still be cached once its own fan is out.
+    // clusterStarts receives the positions in order where the walk had to jump to a dead end.
+    static void tipsify(const std::vector<unsigned int>& indices, size_t vertexCount,
+        std::vector<unsigned int>& order, std::vector<unsigned int>& clusterStarts) {
+        Adjacency adjacency;
+        buildAdjacency(indices, vertexCount, adjacency);
+
+        std::vector<unsigned int> liveTriangles(vertexCount);
+        for (size_t i = 0; i < vertexCount; i++) {
+            liveTriangles[i] = adjacency.offsets[i + 1] - adjacency.offsets[i];
+        }
+
+        const size_t triangleCount = indices.size() / 3;
+        std::vector<unsigned int> timestamps(vertexCount, 0);
+        std::vector<unsigned char> emitted(triangleCount, 0);
+        std::vector<unsigned int> deadEnds;
+        std::vector<unsigned int> candidates;
+        unsigned int time = kCacheSize + 1;
+        size_t cursor = 0;
+
+        order.reserve(triangleCount);
+        clusterStarts.push_back(0);
+        int fanning = skipDeadEnd(liveTriangles, deadEnds, cursor);
+        while (fanning >= 0) {
+            candidates.clear();
+            for (unsigned int i = adjacency.offsets[fanning]; i < adjacency.offsets[fanning + 1]; i++) {
+                unsigned int triangle = adjacency.triangles[i];
+                if (emitted[triangle]) {
+                    continue;
+                }
+
+                for (int corner = 0; corner < 3; corner++) {
+                    unsigned int vertex = indices[(size_t)triangle * 3 + corner];
+                    deadEnds.push_back(vertex);
+                    candidates.push_back(vertex);
+                    liveTriangles[vertex]--;
+                    if (time - timestamps[vertex] > kCacheSize) {
+                        timestamps[vertex] = time++;
+                    }
+                }
+                emitted[triangle] = 1;
+                order.push_back(triangle);
+            }
+
+            int next = -1;
+            int bestPriority = -1;
+            for (unsigned int vertex : candidates) {
+                if (liveTriangles[vertex] == 0) {
+                    continue;
+                }
+
+                // Each of its fan's triangles adds at most two new vertices
+                int priority = 0;
+                unsigned int age = time - timestamps[vertex];
+                if (age + 2 * liveTriangles[vertex] <= kCacheSize) {
+                    priority = (int)age;
+                }
+                if (priority > bestPriority) {
+                    bestPriority = priority;
+                    next = (int)vertex;
+                }
+            }
+
+            if (next == -1) {
+                next = skipDeadEnd(liveTriangles, deadEnds, cursor);
+                if (next >= 0) {
+                    clusterStarts.push_back((unsigned int)order.size());
+                }
+            }
+            fanning = next;
+        }
+    }
+
+    // Cuts each cluster further wherever a fresh cache has already settled to near the mesh's ACMR,
+    // so the sort below has more pieces to work with
+    static void splitClusters(const std::vector<unsigned int>& indices, size_t vertexCount,
+        const std::vector<unsigned int>& order, std::vector<unsigned int>& clusterStarts) {
+        std::vector<unsigned int> timestamps(vertexCount, 0);
+        unsigned int time = kCacheSize + 1;
+        size_t misses = 0;
+        for (unsigned int triangle : order) {
+            for (int corner = 0; corner < 3; corner++) {
+                unsigned int vertex = indices[(size_t)triangle * 3 + corner];
+                if (time - timestamps[vertex] > kCacheSize) {
+                    timestamps[vertex] = time++;
+                    misses++;
+                }
+            }
+        }
+        const float threshold = (float)misses / (float)order.size() * kClusterThreshold;
+
+        std::vector<unsigned int> starts;
+        starts.reserve(clusterStarts.size());
+        for (size_t cluster = 0; cluster < clusterStarts.size(); cluster++) {
+            size_t end = cluster + 1 < clusterStarts.size() ? clusterStarts[cluster + 1] : order.size();
+            size_t clusterMisses = 0;
+            size_t clusterTriangles = 0;
+            time += kCacheSize + 1;
+            starts.push_back(clusterStarts[cluster]);
+
+            for (size_t i = clusterStarts[cluster]; i < end; i++) {
+                for (int corner = 0; corner < 3; corner++) {
+                    unsigned int vertex = indices[(size_t)order[i] * 3 + corner];
+                    if (time - timestamps[vertex] > kCacheSize) {
+                        timestamps[vertex] = time++;
+                        clusterMisses++;
+                    }
+                }
+                clusterTriangles++;
+
+                if (i + 1 < end && (float)clusterMisses / (float)clusterTriangles <= threshold) {
+                    starts.push_back((unsigned int)(i + 1));
+                    clusterMisses = 0;
+                    clusterTriangles = 0;
+                    time += kCacheSize + 1;
+                }
+            }
+        }
+        clusterStarts.swap(starts);
+    }
+
+    void optimizeTriangleOrder(std::vector<unsigned int>& indices, const std::vector<float>& vertices, int floatsPerVertex) {
+        const size_t vertexCount = vertices.size() / floatsPerVertex;
+        if (indices.size() < 3 || indices.size() % 3 != 0) {
+            return;
+        }
+
+        std::vector<unsigned int> order;
+        std::vector<unsigned int> clusterStarts;
+        tipsify(indices, vertexCount, order, clusterStarts);
+        splitClusters(indices, vertexCount, order, clusterStarts);
+
+        // Area-weighted centroid and normal of each cluster and of the whole mesh
+        const size_t clusterCount = clusterStarts.size();
+        std::vector<float> centroids(clusterCount * 3, 0.0f);
+        std::vector<float> normals(clusterCount * 3, 0.0f);
+        std::vector<float> areas(clusterCount, 0.0f);
+        float meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+        float meshArea = 0.0f;
+        for (size_t cluster = 0; cluster < clusterCount; cluster++) {
+            size_t end = cluster + 1 < clusterCount ? clusterStarts[cluster + 1] : order.size();
+            for (size_t i = clusterStarts[cluster]; i < end; i++) {
+                const float* p0 = &vertices[(size_t)indices[(size_t)order[i] * 3] * floatsPerVertex];
+                const float* p1 = &vertices[(size_t)indices[(size_t)order[i] * 3 + 1] * floatsPerVertex];
+                const float* p2 = &vertices[(size_t)indices[(size_t)order[i] * 3 + 2] * floatsPerVertex];
+
+                float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+                float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+                float normal[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+                float area = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+
+                for (int axis = 0; axis < 3; axis++) {
+                    float center = (p0[axis] + p1[axis] + p2[axis]) / 3.0f;
+                    centroids[cluster * 3 + axis] += center * area;
+                    normals[cluster * 3 + axis] += normal[axis];
+                    meshCentroid[axis] += center * area;
+                }
+                areas[cluster] += area;
+                meshArea += area;
+            }
+        }
+        for (int axis = 0; axis < 3; axis++) {
+            meshCentroid[axis] = meshArea > 0.0f ? meshCentroid[axis] / meshArea : 0.0f;
+        }
+
+        // Clusters that face away from the mesh center occlude the rest from most directions, so
+        // they go first
+        std::vector<float> keys(clusterCount, 0.0f);
+        for (size_t cluster = 0; cluster < clusterCount; cluster++) {
+            const float* normal = &normals[cluster * 3];
+            float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            if (areas[cluster] <= 0.0f || length <= 0.0f) {
+                continue;
+            }
+
+            for (int axis = 0; axis < 3; axis++) {
+                float offset = centroids[cluster * 3 + axis] / areas[cluster] - meshCentroid[axis];
+                keys[cluster] += offset * normal[axis] / length;
+            }
+        }
+
+        std::vector<unsigned int> sorted(clusterCount);
+        for (size_t i = 0; i < clusterCount; i++) {
+            sorted[i] = (unsigned int)i;
+        }
+        std::stable_sort(sorted.begin(), sorted.end(), [&](unsigned int a, unsigned int b) {
+            return keys[a] > keys[b];
+        });
+
+        std::vector<unsigned int> reordered;
+        reordered.reserve(indices.size());
+        for (unsigned int cluster : sorted) {
+            size_t end = cluster + 1 < clusterCount ? clusterStarts[cluster + 1] : order.size();
+            for (size_t i = clusterStarts[cluster]; i < end; i++) {
+                for (int corner = 0; corner < 3; corner++) {
+                    reordered.push_back(indices[(size_t)order[i] * 3 + corner]);
+                }
+            }
+        }
+        indices.swap(reordered);
+    }
+
+    void optimizeVertexFetch(std::vector<float>& vertices, int floatsPerVertex, std::vector<unsigned int>& indices) {
+        const unsigned int kUnused = ~0u;
+        std::vector<unsigned int> remap(vertices.size() / floatsPerVertex, kUnused);
+        std::vector<float> reordered;
+        reordered.reserve(vertices.size());
+
+        unsigned int nextVertex = 0;
+        for (unsigned int& index : indices) {
+            if (remap[index] == kUnused) {
+                remap[index] = nextVertex++;
+                const float* vertex = &vertices[(size_t)index * floatsPerVertex];
+                reordered.insert(reordered.end(), vertex, vertex + floatsPerVertex);
+            }
+            index = remap[index];
+        }
+        vertices.swap(reordered);
+    }
+}
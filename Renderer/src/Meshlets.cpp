@@ -0,0 +1,197 @@
+#include "../headers/Meshlets.h"
+#include "../headers/MeshImport.h"
+#include <math.h>
+
+namespace Meshlets {
+    // Meshlets whose triangles stray further than about 84 degrees from the average normal can
+    // face the camera from any side, so their cone is left open
+    static const float kMinConeDot = 0.1f;
+
+    // Largest relative difference between axis scales for which the cone test still holds
+    static const float kUniformScaleTolerance = 0.01f;
+
+    static void getTriangleNormal(const std::vector<float>& vertices, const unsigned int* triangle, float normal[3]) {
+        const int stride = MeshImport::kFloatsPerVertex;
+        const float* p0 = &vertices[(size_t)triangle[0] * stride];
+        const float* p1 = &vertices[(size_t)triangle[1] * stride];
+        const float* p2 = &vertices[(size_t)triangle[2] * stride];
+        float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+        float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+        normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+        normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+        normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+    }
+
+    // Sphere around the AABB center, as computeBounds does for whole meshes, and the cone of the
+    // unit triangle normals around their average
+    static Meshlet computeMeshlet(const MeshData& mesh, unsigned int firstIndex, unsigned int indexCount) {
+        const int stride = MeshImport::kFloatsPerVertex;
+        const unsigned int* indices = &mesh.indices[firstIndex];
+
+        Meshlet meshlet;
+        meshlet.firstIndex = firstIndex;
+        meshlet.indexCount = indexCount;
+
+        float boundsMin[3];
+        float boundsMax[3];
+        for (int axis = 0; axis < 3; axis++) {
+            boundsMin[axis] = boundsMax[axis] = mesh.vertices[(size_t)indices[0] * stride + axis];
+        }
+        for (unsigned int i = 1; i < indexCount; i++) {
+            const float* position = &mesh.vertices[(size_t)indices[i] * stride];
+            for (int axis = 0; axis < 3; axis++) {
+                boundsMin[axis] = position[axis] < boundsMin[axis] ? position[axis] : boundsMin[axis];
+                boundsMax[axis] = position[axis] > boundsMax[axis] ? position[axis] : boundsMax[axis];
+            }
+        }
+
+        float center[3];
+        for (int axis = 0; axis < 3; axis++) {
+            center[axis] = (boundsMin[axis] + boundsMax[axis]) * 0.5f;
+        }
+        float radiusSquared = 0.0f;
+        for (unsigned int i = 0; i < indexCount; i++) {
+            const float* position = &mesh.vertices[(size_t)indices[i] * stride];
+            float dx = position[0] - center[0];
+            float dy = position[1] - center[1];
+            float dz = position[2] - center[2];
+            float distanceSquared = dx * dx + dy * dy + dz * dz;
+            radiusSquared = distanceSquared > radiusSquared ? distanceSquared : radiusSquared;
+        }
+        meshlet.center = vmath::vec3(center[0], center[1], center[2]);
+        meshlet.radius = sqrtf(radiusSquared);
+
+        float coneAxis[3] = { 0.0f, 0.0f, 0.0f };
+        for (unsigned int i = 0; i + 2 < indexCount; i += 3) {
+            float normal[3];
+            getTriangleNormal(mesh.vertices, indices + i, normal);
+            float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            if (length > 0.0f) {
+                for (int axis = 0; axis < 3; axis++) {
+                    coneAxis[axis] += normal[axis] / length;
+                }
+            }
+        }
+
+        float axisLength = sqrtf(coneAxis[0] * coneAxis[0] + coneAxis[1] * coneAxis[1] + coneAxis[2] * coneAxis[2]);
+        meshlet.coneAxis = vmath::vec3(0.0f, 0.0f, 1.0f);
+        meshlet.coneCutoff = 1.0f;
+        if (axisLength <= 0.0f) {
+            return meshlet;
+        }
+        for (int axis = 0; axis < 3; axis++) {
+            coneAxis[axis] /= axisLength;
+        }
+
+        float minDot = 1.0f;
+        for (unsigned int i = 0; i + 2 < indexCount; i += 3) {
+            float normal[3];
+            getTriangleNormal(mesh.vertices, indices + i, normal);
+            float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            if (length > 0.0f) {
+                float dot = (normal[0] * coneAxis[0] + normal[1] * coneAxis[1] + normal[2] * coneAxis[2]) / length;
+                minDot = dot < minDot ? dot : minDot;
+            }
+        }
+
+        meshlet.coneAxis = vmath::vec3(coneAxis[0], coneAxis[1], coneAxis[2]);
+        if (minDot > kMinConeDot) {
+            meshlet.coneCutoff = sqrtf(1.0f - minDot * minDot);
+        }
+        return meshlet;
+    }
+
+    void build(MeshData& mesh) {
+        mesh.meshlets.clear();
+        const unsigned int indexCount = mesh.lods.empty() ? (unsigned int)mesh.indices.size() : mesh.lods[0].indexCount;
+        if (indexCount < 3) {
+            return;
+        }
+
+        // Vertices are counted per meshlet by stamping them with the meshlet's number
+        std::vector<unsigned int> stamps(mesh.vertices.size() / MeshImport::kFloatsPerVertex, ~0u);
+        unsigned int meshletNumber = 0;
+        unsigned int firstIndex = 0;
+        unsigned int vertexCount = 0;
+
+        for (unsigned int i = 0; i + 2 < indexCount; i += 3) {
+            const unsigned int* triangle = &mesh.indices[i];
+            unsigned int newVertices = 0;
+            for (int corner = 0; corner < 3; corner++) {
+                newVertices += stamps[triangle[corner]] != meshletNumber ? 1 : 0;
+            }
+
+            if (i - firstIndex == kMaxTriangles * 3 || vertexCount + newVertices > kMaxVertices) {
+                mesh.meshlets.push_back(computeMeshlet(mesh, firstIndex, i - firstIndex));
+                meshletNumber++;
+                firstIndex = i;
+                vertexCount = 0;
+                newVertices = 3;
+            }
+
+            for (int corner = 0; corner < 3; corner++) {
+                stamps[triangle[corner]] = meshletNumber;
+            }
+            vertexCount += newVertices;
+        }
+        mesh.meshlets.push_back(computeMeshlet(mesh, firstIndex, indexCount / 3 * 3 - firstIndex));
+    }
+
+    size_t cull(const std::vector<Meshlet>& meshlets, const vmath::mat4& modelMatrix, const Frustum& frustum,
+        const vmath::vec3& cameraPosition, std::vector<IndexRange>& ranges) {
+        const vmath::mat4& m = modelMatrix;
+
+        float minScale = 0.0f;
+        float maxScale = 0.0f;
+        for (int column = 0; column < 3; column++) {
+            float scale = sqrtf(m[column][0] * m[column][0] + m[column][1] * m[column][1] + m[column][2] * m[column][2]);
+            minScale = column == 0 || scale < minScale ? scale : minScale;
+            maxScale = scale > maxScale ? scale : maxScale;
+        }
+
+        // A mirrored matrix turns the cone around, a non-uniform scale bends it
+        float determinant = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+            - m[1][0] * (m[0][1] * m[2][2] - m[0][2] * m[2][1])
+            + m[2][0] * (m[0][1] * m[1][2] - m[0][2] * m[1][1]);
+        bool coneCulling = determinant > 0.0f && maxScale - minScale <= maxScale * kUniformScaleTolerance;
+
+        const size_t firstRange = ranges.size();
+        size_t culled = 0;
+        for (const Meshlet& meshlet : meshlets) {
+            const vmath::vec3& c = meshlet.center;
+            vmath::vec3 center(m[0][0] * c[0] + m[1][0] * c[1] + m[2][0] * c[2] + m[3][0],
+                m[0][1] * c[0] + m[1][1] * c[1] + m[2][1] * c[2] + m[3][1],
+                m[0][2] * c[0] + m[1][2] * c[1] + m[2][2] * c[2] + m[3][2]);
+            float radius = meshlet.radius * maxScale;
+            bool visible = frustum.isSphereVisible(center, radius);
+
+            // Every triangle faces away from every point of the sphere
+            if (visible && coneCulling && meshlet.coneCutoff < 1.0f) {
+                const vmath::vec3& a = meshlet.coneAxis;
+                float axis[3] = {
+                    (m[0][0] * a[0] + m[1][0] * a[1] + m[2][0] * a[2]) / maxScale,
+                    (m[0][1] * a[0] + m[1][1] * a[1] + m[2][1] * a[2]) / maxScale,
+                    (m[0][2] * a[0] + m[1][2] * a[1] + m[2][2] * a[2]) / maxScale
+                };
+                float toCenter[3] = { center[0] - cameraPosition[0], center[1] - cameraPosition[1], center[2] - cameraPosition[2] };
+                float distance = sqrtf(toCenter[0] * toCenter[0] + toCenter[1] * toCenter[1] + toCenter[2] * toCenter[2]);
+                float facing = toCenter[0] * axis[0] + toCenter[1] * axis[1] + toCenter[2] * axis[2];
+                visible = facing < meshlet.coneCutoff * distance + radius;
+            }
+
+            if (!visible) {
+                culled++;
+                continue;
+            }
+
+            if (ranges.size() > firstRange && ranges.back().firstIndex + ranges.back().indexCount == meshlet.firstIndex) {
+                ranges.back().indexCount += meshlet.indexCount;
+            }
+            else {
+                IndexRange range = { meshlet.firstIndex, meshlet.indexCount };
+                ranges.push_back(range);
+            }
+        }
+        return culled;
+    }
+}
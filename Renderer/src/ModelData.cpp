@@ -0,0 +1,78 @@
+#include "../headers/ModelData.h"
+
+void buildMipChain(TextureData& texture) {
+    texture.mips.resize(1);
+
+    int width = texture.width;
+    int height = texture.height;
+    const int channels = texture.channels;
+
+    while (width > 1 || height > 1) {
+        const std::vector<unsigned char>& src = texture.mips.back();
+        int nextWidth = width > 1 ? width / 2 : 1;
+        int nextHeight = height > 1 ? height / 2 : 1;
+
+        std::vector<unsigned char> dst((size_t)nextWidth * nextHeight * channels);
+
+        for (int y = 0; y < nextHeight; y++) {
+            // Clamp so odd dimensions reuse the last row/column
+            int y0 = y * 2;
+            int y1 = y0 + 1 < height ? y0 + 1 : y0;
+
+            for (int x = 0; x < nextWidth; x++) {
+                int x0 = x * 2;
+                int x1 = x0 + 1 < width ? x0 + 1 : x0;
+
+                for (int c = 0; c < channels; c++) {
+                    int sum = src[((size_t)y0 * width + x0) * channels + c]
+                        + src[((size_t)y0 * width + x1) * channels + c]
+                        + src[((size_t)y1 * width + x0) * channels + c]
+                        + src[((size_t)y1 * width + x1) * channels + c];
+                    dst[((size_t)y * nextWidth + x) * channels + c] = (unsigned char)((sum + 2) / 4);
+                }
+            }
+        }
+
+        texture.mips.push_back(std::move(dst));
+        width = nextWidth;
+        height = nextHeight;
+    }
+}
+
+BoundingVolume computeBounds(const std::vector<float>& vertices, int floatsPerVertex) {
+    BoundingVolume bounds;
+    bounds.aabbMin = vmath::vec3(0.0f, 0.0f, 0.0f);
+    bounds.aabbMax = vmath::vec3(0.0f, 0.0f, 0.0f);
+    bounds.sphereCenter = vmath::vec3(0.0f, 0.0f, 0.0f);
+    bounds.sphereRadius = 0.0f;
+
+    size_t vertexCount = vertices.size() / floatsPerVertex;
+    if (vertexCount == 0) {
+        return bounds;
+    }
+
+    bounds.aabbMin = vmath::vec3(vertices[0], vertices[1], vertices[2]);
+    bounds.aabbMax = bounds.aabbMin;
+    for (size_t i = 1; i < vertexCount; i++) {
+        const float* position = &vertices[i * floatsPerVertex];
+        for (int axis = 0; axis < 3; axis++) {
+            bounds.aabbMin[axis] = position[axis] < bounds.aabbMin[axis] ? position[axis] : bounds.aabbMin[axis];
+            bounds.aabbMax[axis] = position[axis] > bounds.aabbMax[axis] ? position[axis] : bounds.aabbMax[axis];
+        }
+    }
+
+    // Centered on the box, but sized to the farthest vertex rather than the box corner
+    bounds.sphereCenter = (bounds.aabbMin + bounds.aabbMax) * 0.5f;
+    float radiusSquared = 0.0f;
+    for (size_t i = 0; i < vertexCount; i++) {
+        const float* position = &vertices[i * floatsPerVertex];
+        float dx = position[0] - bounds.sphereCenter[0];
+        float dy = position[1] - bounds.sphereCenter[1];
+        float dz = position[2] - bounds.sphereCenter[2];
+        float distanceSquared = dx * dx + dy * dy + dz * dz;
+        radiusSquared = distanceSquared > radiusSquared ? distanceSquared : radiusSquared;
+    }
+    bounds.sphereRadius = sqrtf(radiusSquared);
+
+    return bounds;
+}
@@ -0,0 +1,209 @@
+#include "../headers/Profiler.h"
+#include <algorithm>
+#include <stdio.h>
+
+static const char* const kCounterNames[Profiler::Counter_Count] = {
+    "draw calls",
+    "state changes",
+    "triangles",
+    "upload bytes",
+    "culled meshes",
+    "culled meshlets"
+};
+
+void Profiler::Series::add(double value) {
+    samples[next] = value;
+    next = (next + 1) % samples.size();
+    count = std::min(count + 1, samples.size());
+}
+
+double Profiler::Series::getPercentile(double percentile) const {
+    if (count == 0) {
+        return 0.0;
+    }
+
+    std::vector<double> sorted(samples.begin(), samples.begin() + count);
+    size_t rank = std::min((size_t)(percentile / 100.0 * count), count - 1);
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    return sorted[rank];
+}
+
+double Profiler::Series::getMean() const {
+    if (count == 0) {
+        return 0.0;
+    }
+
+    double total = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        total += samples[i];
+    }
+    return total / count;
+}
+
+Profiler::Profiler() : frameSeries(0), frameStarted(false), frameSlot(0) {
+    for (int i = 0; i < Counter_Count; i++) {
+        counterSeries[i] = 0;
+        frameCounters[i] = 0;
+    }
+}
+
+void Profiler::startup() {
+    frameSeries = addSeries("frame ms");
+    for (int i = 0; i < Counter_Count; i++) {
+        counterSeries[i] = addSeries(kCounterNames[i]);
+    }
+    frameStarted = false;
+    frameSlot = 0;
+}
+
+void Profiler::shutdown() {
+    for (ZoneRecord& zone : zones) {
+        if (zone.gpu) {
+            glDeleteQueries(kFramesInFlight, zone.queries);
+        }
+    }
+    zones.clear();
+    series.clear();
+}
+
+Profiler::Zone Profiler::addZone(const std::string& name, bool gpu) {
+    ZoneRecord zone;
+    zone.gpu = gpu;
+    zone.cpuMilliseconds = 0.0;
+    zone.cpuSeries = addSeries("cpu " + name + " ms");
+    zone.gpuSeries = 0;
+    for (int i = 0; i < kFramesInFlight; i++) {
+        zone.queries[i] = 0;
+        zone.queryIssued[i] = false;
+    }
+
+    if (gpu) {
+        glGenQueries(kFramesInFlight, zone.queries);
+        zone.gpuSeries = addSeries("gpu " + name + " ms");
+    }
+
+    zones.push_back(zone);
+    return (Zone)zones.size() - 1;
+}
+
+size_t Profiler::addSeries(const std::string& name) {
+    Series newSeries;
+    newSeries.name = name;
+    newSeries.samples.resize(kHistoryFrames);
+    newSeries.next = 0;
+    newSeries.count = 0;
+    series.push_back(newSeries);
+    return series.size() - 1;
+}
+
+void Profiler::beginFrame() {
+    Clock::time_point now = Clock::now();
+
+    // The frame time spans begin to begin, so it includes the swap and event polling
+    if (frameStarted) {
+        series[frameSeries].add(std::chrono::duration<double, std::milli>(now - frameStart).count());
+    }
+    frameStart = now;
+    frameStarted = true;
+
+    frameSlot = (frameSlot + 1) % kFramesInFlight;
+    collectQueries(frameSlot);
+
+    for (ZoneRecord& zone : zones) {
+        zone.cpuMilliseconds = 0.0;
+    }
+    for (int i = 0; i < Counter_Count; i++) {
+        frameCounters[i] = 0;
+    }
+}
+
+void Profiler::endFrame() {
+    for (ZoneRecord& zone : zones) {
+        series[zone.cpuSeries].add(zone.cpuMilliseconds);
+    }
+    for (int i = 0; i < Counter_Count; i++) {
+        series[counterSeries[i]].add((double)frameCounters[i]);
+    }
+}
+
+void Profiler::beginZone(Zone zone) {
+    ZoneRecord& record = zones[zone];
+    if (record.gpu && !record.queryIssued[frameSlot]) {
+        glBeginQuery(GL_TIME_ELAPSED, record.queries[frameSlot]);
+    }
+    record.cpuStart = Clock::now();
+}
+
+void Profiler::endZone(Zone zone) {
+    ZoneRecord& record = zones[zone];
+    record.cpuMilliseconds += std::chrono::duration<double, std::milli>(Clock::now() - record.cpuStart).count();
+
+    // A zone entered twice in one frame only times its first pass on the GPU
+    if (record.gpu && !record.queryIssued[frameSlot]) {
+        glEndQuery(GL_TIME_ELAPSED);
+        record.queryIssued[frameSlot] = true;
+    }
+}
+
+// Reads back the queries issued kFramesInFlight frames ago; results that are still pending are dropped
+void Profiler::collectQueries(int slot) {
+    for (ZoneRecord& zone : zones) {
+        if (!zone.gpu || !zone.queryIssued[slot]) {
+            continue;
+        }
+
+        GLint available = 0;
+        glGetQueryObjectiv(zone.queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(zone.queries[slot], GL_QUERY_RESULT, &nanoseconds);
+            series[zone.gpuSeries].add(nanoseconds / 1000000.0);
+        }
+        zone.queryIssued[slot] = false;
+    }
+}
+
+bool Profiler::exportCsv(const std::string& path) const {
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file) {
+        OutputDebugStringA(("\nFailed to write profile to " + path).c_str());
+        return false;
+    }
+
+    writeCsv(file);
+    fclose(file);
+    OutputDebugStringA(("\nProfile written to " + path).c_str());
+    return true;
+}
+
+void Profiler::writeCsv(FILE* file) const {
+    fprintf(file, "metric,p50,p95,p99,mean,samples\n");
+    for (const Series& metric : series) {
+        fprintf(file, "%s,%.4f,%.4f,%.4f,%.4f,%zu\n", metric.name.c_str(), metric.getPercentile(50.0),
+            metric.getPercentile(95.0), metric.getPercentile(99.0), metric.getMean(), metric.count);
+    }
+}
+
+std::string Profiler::getSummary() const {
+    if (series.empty()) {
+        return std::string();
+    }
+
+    char text[128];
+    const Series& frame = series[frameSeries];
+    snprintf(text, sizeof(text), "frame p50 %.2f / p99 %.2f ms", frame.getPercentile(50.0), frame.getPercentile(99.0));
+    std::string summary = text;
+
+    for (const ZoneRecord& zone : zones) {
+        if (zone.gpu) {
+            const Series& gpu = series[zone.gpuSeries];
+            snprintf(text, sizeof(text), " | %s p50 %.2f ms", gpu.name.c_str(), gpu.getPercentile(50.0));
+            summary += text;
+        }
+    }
+
+    snprintf(text, sizeof(text), " | %.0f draws, %.0f tris, %.0f culled", series[counterSeries[Counter_DrawCalls]].getPercentile(50.0),
+        series[counterSeries[Counter_Triangles]].getPercentile(50.0), series[counterSeries[Counter_CulledMeshes]].getPercentile(50.0));
+    summary += text;
+    return summary;
+}
@@ -1,24 +1,138 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "../headers/Renderer.h"
+#include "../headers/MeshImport.h"
+#include "../headers/MeshCache.h"
+#include "../headers/Frustum.h"
+#include "../headers/TextureCompression.h"
+#include "../headers/LevelOfDetail.h"
 #include "stb_image.h"
+#include <algorithm>
+#include <float.h>
+#include <set>
+
+static const size_t kUploadRingSize = 32 * 1024 * 1024;
+static const size_t kUploadBytesPerFrame = 8 * 1024 * 1024;
+static const size_t kTextureBudgetBytes = 512 * 1024 * 1024;
+static const unsigned int kArenaInitialVertices = 256 * 1024;
+static const unsigned int kArenaInitialIndices = 1024 * 1024;
+static const unsigned int kInitialInstances = 1024;
+static const double kProfilerTitleInterval = 0.5; // Seconds between window title refreshes
+static const char* const kProfileCsvPath = "profile.csv";
+
+// Matches MeshImport's interleaved layout and the textured shader's attribute locations
+static VertexFormat getInterleavedVertexFormat() {
+    VertexFormat format;
+    format.stride = MeshImport::kFloatsPerVertex * sizeof(float);
+    format.attributes.push_back({ 0, 3, GL_FLOAT, GL_FALSE, 0 });                  // Position
+    format.attributes.push_back({ 1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float) });  // Normal
+    format.attributes.push_back({ 2, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float) });  // Tangent
+    format.attributes.push_back({ 3, 2, GL_FLOAT, GL_FALSE, 9 * sizeof(float) });  // Texture coordinates
+    return format;
+}
+
+// VertexQuantization's packed layout, same attribute locations
+static VertexFormat getCompactVertexFormat() {
+    VertexFormat format;
+    format.stride = VertexQuantization::kCompactStride;
+    format.attributes.push_back({ 0, 3, GL_UNSIGNED_SHORT, GL_TRUE, VertexQuantization::kPositionOffset });
+    format.attributes.push_back({ 1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, VertexQuantization::kNormalOffset });
+    format.attributes.push_back({ 2, 4, GL_INT_2_10_10_10_REV, GL_TRUE, VertexQuantization::kTangentOffset });
+    format.attributes.push_back({ 3, 2, GL_HALF_FLOAT, GL_FALSE, VertexQuantization::kTexCoordOffset });
+    return format;
+}
 
-void Renderer::startup(int width, int height) {
+void Renderer::startup(int width, int height, const std::string& modelPath, const GeometrySettings& settings) {
     windowWidth = width;
     windowHeight = height;
-
-    loadShaders("textured", texturedShaderProgram);
+    geometrySettings = settings; // Read by the import workers, so set before they start
+
+    // Streaming uploads (copied on a thread with its own shared context), shared geometry,
+    // the GPU material table and import workers
+    uploadRing.startup(kUploadRingSize, glfwGetCurrentContext());
+    VertexFormat vertexFormat = geometrySettings.vertexLayout == VertexQuantization::VertexLayout_Compact ? getCompactVertexFormat() : getInterleavedVertexFormat();
+    geometryArena.startup(vertexFormat, kArenaInitialVertices, kArenaInitialIndices, &uploadRing);
+    materialSystem.startup(&uploadRing, true);
+    textureResidency.startup(&materialSystem, kTextureBudgetBytes);
+    instanceBuffer.startup(kInitialInstances);
+    threadPool.startup(0);
+    assetManager.startup(&threadPool, [this](const std::string& path, ModelData& modelData) {
+        return loadModelData(path, modelData);
+    });
+
+    profiler.startup();
+    uploadZone = profiler.addZone("upload", true);
+    renderZone = profiler.addZone("render", true);
+    swapZone = profiler.addZone("swap", false);
+    streamZone = profiler.addZone("stream", false);
+    meshletZone = profiler.addZone("meshlet cull", false);
+
+    // Materials are sampled through texture arrays, or resident handles when bindless is available
+    std::string fragmentShaderName = materialSystem.isBindless() ? "texturedBindless" : "textured";
+    loadShaders("textured", fragmentShaderName, texturedShaderProgram);
 
     // Get uniform locations
     modelLocation = glGetUniformLocation(texturedShaderProgram, "modelMatrix");
     viewLocation = glGetUniformLocation(texturedShaderProgram, "viewMatrix");
     projLocation = glGetUniformLocation(texturedShaderProgram, "projMatrix");
-    diffuseSamplerLocation = glGetUniformLocation(texturedShaderProgram, "diffuseSampler");
-    normalSamplerLocation = glGetUniformLocation(texturedShaderProgram, "normalSampler");
-    matValidityCheckLocation = glGetUniformLocation(texturedShaderProgram, "isValidMaterial");
+    materialIndexLocation = glGetUniformLocation(texturedShaderProgram, "materialIndex");
+    firstInstanceLocation = glGetUniformLocation(texturedShaderProgram, "firstInstance");
+    positionDequantLocation = glGetUniformLocation(texturedShaderProgram, "positionDequant");
+    textureArraysLocation = glGetUniformLocation(texturedShaderProgram, "textureArrays");
     lightDirectionLocation = glGetUniformLocation(texturedShaderProgram, "lightDir");
     lightColorLocation = glGetUniformLocation(texturedShaderProgram, "lightColor");
     viewPosLocation = glGetUniformLocation(texturedShaderProgram, "viewPos");
 
+    // Multi-draw-indirect needs gl_DrawIDARB, otherwise stay on the per-mesh path
+    renderMode = RenderMode_Direct;
+    indirectShaderProgram = 0;
+    drawCommandBuffer = 0;
+    drawDataBuffer = 0;
+    indirectDrawCount = 0;
+    indirectShortDrawCount = 0;
+    indirectTriangleCount = 0;
+    indirectDirty = cullRecordsDirty = true;
+    if (gl3wIsSupported(4, 6) || glfwExtensionSupported("GL_ARB_shader_draw_parameters")) {
+        loadShaders("texturedIndirect", fragmentShaderName, indirectShaderProgram);
+        indirectViewLocation = glGetUniformLocation(indirectShaderProgram, "viewMatrix");
+        indirectProjLocation = glGetUniformLocation(indirectShaderProgram, "projMatrix");
+        indirectAnimationLocation = glGetUniformLocation(indirectShaderProgram, "animationMatrix");
+        indirectTextureArraysLocation = glGetUniformLocation(indirectShaderProgram, "textureArrays");
+        indirectLightDirectionLocation = glGetUniformLocation(indirectShaderProgram, "lightDir");
+        indirectDrawOffsetLocation = glGetUniformLocation(indirectShaderProgram, "drawOffset");
+        indirectLightColorLocation = glGetUniformLocation(indirectShaderProgram, "lightColor");
+        indirectViewPosLocation = glGetUniformLocation(indirectShaderProgram, "viewPos");
+
+        glGenBuffers(1, &drawCommandBuffer);
+        glGenBuffers(1, &drawDataBuffer);
+        renderMode = RenderMode_Indirect;
+    }
+
+    // With compute culling and an indirect draw count the CPU never touches individual meshes
+    culledShaderProgram = 0;
+    if (GpuCulling::isSupported()) {
+        gpuCulling.startup();
+        loadShaders("texturedCulled", fragmentShaderName, culledShaderProgram);
+        culledViewLocation = glGetUniformLocation(culledShaderProgram, "viewMatrix");
+        culledProjLocation = glGetUniformLocation(culledShaderProgram, "projMatrix");
+        culledAnimationLocation = glGetUniformLocation(culledShaderProgram, "animationMatrix");
+        culledTextureArraysLocation = glGetUniformLocation(culledShaderProgram, "textureArrays");
+        culledLightDirectionLocation = glGetUniformLocation(culledShaderProgram, "lightDir");
+        culledDrawOffsetLocation = glGetUniformLocation(culledShaderProgram, "drawOffset");
+        culledLightColorLocation = glGetUniformLocation(culledShaderProgram, "lightColor");
+        culledViewPosLocation = glGetUniformLocation(culledShaderProgram, "viewPos");
+        renderMode = RenderMode_GpuCulled;
+    }
+
+    // Every vertex shader decodes both layouts; the arena's layout is fixed for the run
+    GLuint programs[] = { texturedShaderProgram, indirectShaderProgram, culledShaderProgram };
+    for (GLuint program : programs) {
+        if (program) {
+            glUseProgram(program);
+            glUniform1i(glGetUniformLocation(program, "octahedralNormals"), geometrySettings.vertexLayout == VertexQuantization::VertexLayout_Compact);
+        }
+    }
+    glUseProgram(0);
+
     // Setup matrices projection and view matrices
     float aspect = (float) windowWidth / (float) windowHeight;
     projMatrix = vmath::perspective(50.0f, aspect, 0.1f, 1000.0f);
@@ -27,9 +141,11 @@ void Renderer::startup(int width, int height) {
     vmath::vec3 cameraTarget = vmath::vec3(0.0f, 0.0f, 0.0f);
     vmath::vec3 cameraUp = vmath::vec3(0.0f, 1.0f, 0.0f);
     viewMatrix = vmath::lookat(cameraPos, cameraTarget, cameraUp);
+    cameraPosition = cameraPos;
 
-    // Model load test
-    gameObject = loadModel("../Assets/Models/haloSpartan2.glb");
+    // The first frames draw nothing until the model streams in
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // RGB mips are tightly packed
+    requestModel(modelPath);
 
     // OpenGL settings    
     glViewport(0, 0, windowWidth, windowHeight);
@@ -42,79 +158,863 @@ void Renderer::startup(int width, int height) {
 }
 
 void Renderer::shutdown() {
-    for (Mesh mesh : gameObject.meshes) {
-        glDeleteProgram(texturedShaderProgram);
-        glDeleteVertexArrays(1, &mesh.VAO);
-        glDeleteBuffers(1, &mesh.VBO);
-        glDeleteBuffers(1, &mesh.EBO);
+    // Workers may still be importing; they finish before the pool goes away
+    assetManager.shutdown();
+    threadPool.shutdown();
+
+    for (GameObject& object : gameObjects) {
+        unloadGameObject(object);
+    }
+    gameObjects.clear();
+    pendingInstances.clear();
+
+    // Stop the upload thread before the textures and buffers it writes to go away
+    textureResidency.shutdown();
+    profiler.shutdown();
+    uploadRing.shutdown();
+    materialSystem.shutdown();
+    geometryArena.shutdown();
+    instanceBuffer.shutdown();
+    glDeleteProgram(texturedShaderProgram);
+    if (indirectShaderProgram) {
+        glDeleteProgram(indirectShaderProgram);
+        glDeleteBuffers(1, &drawCommandBuffer);
+        glDeleteBuffers(1, &drawDataBuffer);
+    }
+    if (culledShaderProgram) {
+        glDeleteProgram(culledShaderProgram);
+        gpuCulling.shutdown();
+    }
+}
+
+void Renderer::unloadGameObject(GameObject& object) {
+    // Arena ranges go back on the free list and are reused by the next load
+    for (const Mesh& mesh : object.meshes) {
+        geometryArena.free(mesh.geometry);
+    }
+
+    for (GLuint materialId : object.materialIds) {
+        materialSystem.releaseMaterial(materialId);
+    }
+
+    // Textures shared with other models stay until their last user goes
+    std::vector<int> releasedTextures;
+    for (int textureId : object.textureIds) {
+        if (materialSystem.releaseTexture(textureId)) {
+            releasedTextures.push_back(textureId);
+        }
+    }
+    textureResidency.removeTextures(releasedTextures);
+
+    // Nodes after the removed range shift down, so objects placed later follow them
+    sceneGraph.removeNodes(object.rootNode, object.nodeCount);
+    for (GameObject& other : gameObjects) {
+        if (&other != &object && other.rootNode > object.rootNode) {
+            other.rootNode -= object.nodeCount;
+            for (Mesh& mesh : other.meshes) {
+                mesh.node -= object.nodeCount;
+            }
+        }
+    }
+    object.nodeCount = 0;
+
+    instanceBuffer.free(object.firstInstance, object.instanceCount);
+    object.instanceCount = 0;
+
+    object.meshes.clear();
+    object.materialIds.clear();
+    object.textureIds.clear();
+    indirectDirty = cullRecordsDirty = true;
+}
+
+AssetManager::Handle Renderer::requestModel(const std::string& path) {
+    return assetManager.requestModel(path);
+}
+
+AssetManager::State Renderer::getModelState(AssetManager::Handle handle) const {
+    return assetManager.getState(handle);
+}
+
+void Renderer::unloadModel(AssetManager::Handle handle) {
+    assetManager.release(handle);
+    pendingInstances.erase(handle);
+
+    for (size_t i = 0; i < gameObjects.size(); i++) {
+        if (gameObjects[i].handle == handle) {
+            unloadGameObject(gameObjects[i]);
+            gameObjects.erase(gameObjects.begin() + i);
+            return;
+        }
+    }
+}
+
+void Renderer::setInstances(AssetManager::Handle handle, const std::vector<vmath::mat4>& transforms) {
+    for (GameObject& object : gameObjects) {
+        if (object.handle == handle) {
+            applyInstances(object, transforms);
+            return;
+        }
+    }
+
+    // Still loading; applied when the object is created
+    pendingInstances[handle] = transforms;
+}
+
+void Renderer::setInstanceTransform(AssetManager::Handle handle, unsigned int index, const vmath::mat4& transform) {
+    for (GameObject& object : gameObjects) {
+        if (object.handle == handle) {
+            if (index < object.instanceCount) {
+                instanceBuffer.setTransform(object.firstInstance + index, transform);
+            }
+            return;
+        }
+    }
+
+    std::map<AssetManager::Handle, std::vector<vmath::mat4>>::iterator pending = pendingInstances.find(handle);
+    if (pending != pendingInstances.end() && index < pending->second.size()) {
+        pending->second[index] = transform;
+    }
+}
+
+// Replaces the object's instance range; the draws pick up the new count on the next frame
+void Renderer::applyInstances(GameObject& object, const std::vector<vmath::mat4>& transforms) {
+    unsigned int count = (unsigned int)transforms.size();
+    if (count != object.instanceCount) {
+        instanceBuffer.free(object.firstInstance, object.instanceCount);
+        object.firstInstance = 0;
+        object.instanceCount = 0;
+        if (count > 0 && !instanceBuffer.allocate(count, object.firstInstance)) {
+            OutputDebugStringA("\nFailed to allocate instances");
+            count = 0;
+        }
+        object.instanceCount = count;
+
+        for (Mesh& mesh : object.meshes) {
+            mesh.firstInstance = object.firstInstance;
+            mesh.instanceCount = object.instanceCount;
+        }
+        indirectDirty = cullRecordsDirty = true;
+    }
+
+    for (unsigned int i = 0; i < object.instanceCount; i++) {
+        instanceBuffer.setTransform(object.firstInstance + i, transforms[i]);
+    }
+}
+
+// Creates GL objects for at most one finished load per frame, so a burst of completed
+// imports doesn't land in a single frame. The data itself streams in through the upload ring.
+void Renderer::streamAssets() {
+    AssetManager::Handle handle;
+    ModelData modelData;
+    if (!assetManager.takeLoaded(handle, modelData)) {
+        return;
+    }
 
-        mesh.vertices.clear();
-        mesh.indices.clear();
+    gameObjects.push_back(createGameObject(modelData));
+    gameObjects.back().handle = handle;
+
+    std::map<AssetManager::Handle, std::vector<vmath::mat4>>::iterator pending = pendingInstances.find(handle);
+    if (pending != pendingInstances.end()) {
+        applyInstances(gameObjects.back(), pending->second);
+        pendingInstances.erase(pending);
     }
+    assetManager.markResident(handle);
+    indirectDirty = cullRecordsDirty = true;
+}
 
-    for (GLuint textureId : allUsedTextureIds) {
-        glDeleteTextures(1, &textureId);
+// Propagates changed node transforms into the meshes that hang off them
+void Renderer::updateTransforms() {
+    if (sceneGraph.update() == 0) {
+        return;
+    }
+
+    for (GameObject& object : gameObjects) {
+        for (Mesh& mesh : object.meshes) {
+            if (sceneGraph.wasUpdated(mesh.node)) {
+                mesh.modelMatrix = sceneGraph.getWorldMatrix(mesh.node);
+                indirectDirty = cullRecordsDirty = true;
+            }
+        }
     }
 }
 
 void Renderer::runGameLoop(GLFWwindow* window)
 {
     bool running = true;
+    bool modeKeyWasDown = false;
+    bool exportKeyWasDown = false;
+    double lastTitleUpdate = 0.0;
     do
     {
-        render(glfwGetTime());
-        glfwSwapBuffers(window);
+        profiler.beginFrame();
+
+        {
+            ProfileScope scope(profiler, streamZone);
+            streamAssets();
+        }
+
+        // Spread pending mesh and texture uploads across frames
+        {
+            ProfileScope scope(profiler, uploadZone);
+            profiler.addCount(Profiler::Counter_UploadBytes, uploadRing.flush(kUploadBytesPerFrame));
+        }
+
+        {
+            ProfileScope scope(profiler, renderZone);
+            render(glfwGetTime());
+        }
+
+        {
+            ProfileScope scope(profiler, swapZone);
+            glfwSwapBuffers(window);
+        }
         glfwPollEvents();
 
+        profiler.endFrame();
+
+        // The window title doubles as the stats overlay
+        if (glfwGetTime() - lastTitleUpdate > kProfilerTitleInterval) {
+            const TextureResidency::Stats& textureStats = textureResidency.getStats();
+            char textureSummary[64];
+            snprintf(textureSummary, sizeof(textureSummary), " | textures %zu/%zu MB", textureStats.residentBytes >> 20, textureStats.budgetBytes >> 20);
+            glfwSetWindowTitle(window, ("Renderer | " + profiler.getSummary() + textureSummary).c_str());
+            lastTitleUpdate = glfwGetTime();
+        }
+
+        // P writes the current percentiles to CSV, as does exiting
+        bool exportKeyDown = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+        if (exportKeyDown && !exportKeyWasDown) {
+            profiler.exportCsv(kProfileCsvPath);
+        }
+        exportKeyWasDown = exportKeyDown;
+
+        // I cycles through per-mesh, multi-draw-indirect, GPU-culled and meshlet submission
+        bool modeKeyDown = glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS;
+        if (modeKeyDown && !modeKeyWasDown) {
+            if (renderMode == RenderMode_Direct && indirectShaderProgram) {
+                renderMode = RenderMode_Indirect;
+            }
+            else if ((renderMode == RenderMode_Direct || renderMode == RenderMode_Indirect) && culledShaderProgram) {
+                renderMode = RenderMode_GpuCulled;
+            }
+            else if (renderMode != RenderMode_Meshlets && indirectShaderProgram) {
+                renderMode = RenderMode_Meshlets;
+            }
+            else {
+                renderMode = RenderMode_Direct;
+            }
+        }
+        modeKeyWasDown = modeKeyDown;
+
         running &= (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_RELEASE);
         running &= (glfwWindowShouldClose(window) != GL_TRUE);
     } while (running);
+
+    profiler.exportCsv(kProfileCsvPath);
+}
+
+void Renderer::runHeadless(int frameCount, double timeStep) {
+    // Offscreen target, so nothing depends on the (hidden) window's default framebuffer
+    GLuint framebuffer;
+    GLuint renderbuffers[2];
+    glGenFramebuffers(1, &framebuffer);
+    glGenRenderbuffers(2, renderbuffers);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, windowWidth, windowHeight);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, windowWidth, windowHeight);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        OutputDebugStringA("\nHeadless framebuffer incomplete");
+    }
+
+    // The model is resident and every upload has landed before the first timed frame,
+    // so each run draws the same images
+    while (assetManager.isBusy() || !uploadRing.isIdle()) {
+        streamAssets();
+        uploadRing.flush(kUploadBytesPerFrame);
+        std::this_thread::yield();
+    }
+    glFinish();
+
+    for (int frame = 0; frame < frameCount; frame++) {
+        double time = frame * timeStep;
+
+        // Orbit the model at the startup camera's distance
+        float angle = (float)(time * 0.5);
+        cameraPosition = vmath::vec3(3.0f * sinf(angle), 0.0f, 3.0f * cosf(angle));
+        viewMatrix = vmath::lookat(cameraPosition, vmath::vec3(0.0f, 0.0f, 0.0f), vmath::vec3(0.0f, 1.0f, 0.0f));
+
+        profiler.beginFrame();
+
+        // Residency changes queue mip uploads while the timed frames run
+        {
+            ProfileScope scope(profiler, uploadZone);
+            profiler.addCount(Profiler::Counter_UploadBytes, uploadRing.flush(kUploadBytesPerFrame));
+        }
+
+        {
+            ProfileScope scope(profiler, renderZone);
+            render(time);
+        }
+
+        // No swap to pace frames, so wait for the GPU to keep frame times honest
+        glFinish();
+        profiler.endFrame();
+    }
+    profiler.beginFrame(); // Records the last frame's time
+
+    // FNV-1a over the final image
+    std::vector<unsigned char> pixels((size_t)windowWidth * windowHeight * 4);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, windowWidth, windowHeight, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    unsigned long long checksum = 14695981039346656037ull;
+    for (unsigned char value : pixels) {
+        checksum = (checksum ^ value) * 1099511628211ull;
+    }
+
+    printf("frames %d, timestep %.4f s, %dx%d, checksum %016llx\n", frameCount, timeStep, windowWidth, windowHeight, checksum);
+    profiler.writeCsv(stdout);
+    fflush(stdout);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteRenderbuffers(2, renderbuffers);
+    glDeleteFramebuffers(1, &framebuffer);
+}
+
+void Renderer::runBudgetCycle(const std::string& modelPath, int cycleCount) {
+    const int kMaxFramesPerPhase = 2000;
+    size_t budget = textureResidency.getBudget();
+    int droppedBefore = materialSystem.getDroppedTextureCount();
+    int deferredBefore = materialSystem.getDeferredLevelChangeCount();
+    int mostArrays = 0;
+
+    // With a zero budget every texture should end up at its smallest mip
+    std::set<int> textureIds;
+    for (const GameObject& object : gameObjects) {
+        for (int textureId : object.textureIds) {
+            if (textureId >= 0) {
+                textureIds.insert(textureId);
+            }
+        }
+    }
+    size_t floorBytes = 0;
+    for (int textureId : textureIds) {
+        floorBytes += materialSystem.getTextureBytes(textureId, materialSystem.getLevelCount(textureId) - 1);
+    }
+    int phasesAtFloor = 0;
+
+    // Every phase runs until residency stops changing levels, so each texture moves through
+    // every mip count and the arrays that go with them
+    for (int phase = 0; phase < cycleCount * 2; phase++) {
+        textureResidency.setBudget(phase % 2 == 0 ? 0 : budget);
+        for (int frame = 0; frame < kMaxFramesPerPhase; frame++) {
+            uploadRing.flush(kUploadBytesPerFrame);
+            render(frame / 60.0);
+            glFinish();
+
+            int arrayCount = materialSystem.getArrayCount();
+            mostArrays = arrayCount > mostArrays ? arrayCount : mostArrays;
+            const TextureResidency::Stats& stats = textureResidency.getStats();
+            if (stats.promotions == 0 && stats.evictions == 0 && uploadRing.isIdle()) {
+                break;
+            }
+        }
+        phasesAtFloor += phase % 2 == 0 && textureResidency.getStats().residentBytes <= floorBytes ? 1 : 0;
+    }
+
+    requestModel(modelPath);
+    while (assetManager.isBusy() || !uploadRing.isIdle()) {
+        streamAssets();
+        uploadRing.flush(kUploadBytesPerFrame);
+        std::this_thread::yield();
+    }
+
+    printf("budget cycles %d, reached the smallest mips %d/%d, level changes deferred %d, texture arrays %d/%d (most %d), textures dropped by the load %d\n",
+        cycleCount, phasesAtFloor, cycleCount, materialSystem.getDeferredLevelChangeCount() - deferredBefore,
+        materialSystem.getArrayCount(), MaterialSystem::kMaxTextureArrays, mostArrays, materialSystem.getDroppedTextureCount() - droppedBefore);
+    fflush(stdout);
 }
 
+static const GLfloat lightDirection[] = { -0.5f, -0.5f, -0.5f };
+static const GLfloat lightColor[] = { 1.0f, 1.0f, 1.0f };
+
 void Renderer::render(double currentTime) {
-    static const GLfloat lightDirection[] = { -0.5f, -0.5f, -0.5f };    
-    static const GLfloat lightColor[] = { 1.0f, 1.0f, 1.0f };
-    
+    updateTransforms();
+    materialSystem.update(); // Swap in textures whose new mip range has been uploaded
+
+    // Only the instances moved since the last frame
+    profiler.addCount(Profiler::Counter_UploadBytes, instanceBuffer.flush());
+
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+    if (renderMode == RenderMode_Meshlets) {
+        renderMeshlets(currentTime);
+    }
+    else if (renderMode == RenderMode_GpuCulled) {
+        renderGpuCulled(currentTime);
+    }
+    else if (renderMode == RenderMode_Indirect) {
+        renderIndirect(currentTime);
+    }
+    else {
+        renderDirect(currentTime);
+    }
+
+    // Culling reported what was drawn at which size; adjust mips for the next frames
+    textureResidency.update();
+}
+
+// Collects the uploaded meshes whose bounds intersect the view frustum this frame and picks their
+// LOD. An instanced mesh is kept, with all of its instances, as soon as one instance is visible,
+// and its nearest visible instance picks the level for all of them.
+void Renderer::cullMeshes(const vmath::mat4& animationMatrix, std::vector<const Mesh*>& visibleMeshes) {
+    Frustum frustum;
+    frustum.extract(projMatrix * viewMatrix);
+
+    visibleMeshes.clear();
+    for (GameObject& object : gameObjects) {
+        for (Mesh& mesh : object.meshes) {
+            // Meshes whose data is still streaming in are simply not drawn yet
+            if (!uploadRing.isSubmitted(mesh.uploadTicket) || mesh.geometry.indexCount == 0 || mesh.instanceCount == 0) {
+                continue;
+            }
+
+            vmath::mat4 meshMatrix = mesh.modelMatrix * animationMatrix;
+            bool visible = false;
+            float largestSize = 0.0f;
+            float pixelsPerUnit = 0.0f;
+            for (unsigned int i = mesh.firstInstance; i < mesh.firstInstance + mesh.instanceCount; i++) {
+                vmath::mat4 modelMatrix = instanceBuffer.getTransform(i) * meshMatrix;
+                if (!frustum.isVisible(mesh.bounds, modelMatrix)) {
+                    continue;
+                }
+
+                visible = true;
+                largestSize = std::max(largestSize, getProjectedSize(mesh.bounds, modelMatrix));
+
+                // Without coarser levels any visible instance settles it
+                if (mesh.lodCount <= 1) {
+                    break;
+                }
+                pixelsPerUnit = std::max(pixelsPerUnit, getPixelsPerUnit(mesh.bounds, modelMatrix));
+            }
+
+            if (visible) {
+                textureResidency.requestMaterial(mesh.materialIndex, largestSize);
+
+                // A new level changes the indirect commands too
+                int lod = LevelOfDetail::selectLod(mesh.lods, mesh.lodCount, mesh.lod, pixelsPerUnit);
+                if (lod != mesh.lod) {
+                    mesh.lod = lod;
+                    indirectDirty = true;
+                }
+                visibleMeshes.push_back(&mesh);
+            }
+            else {
+                profiler.addCount(Profiler::Counter_CulledMeshes, 1);
+            }
+        }
+    }
+
+    // 16-bit meshes first, so each index type's VAO is bound once
+    std::stable_partition(visibleMeshes.begin(), visibleMeshes.end(), [](const Mesh* mesh) {
+        return mesh->geometry.indexType == GL_UNSIGNED_SHORT;
+    });
+}
+
+// Approximate on-screen diameter in pixels of the mesh's bounding sphere
+float Renderer::getProjectedSize(const BoundingVolume& bounds, const vmath::mat4& modelMatrix) const {
+    vmath::vec4 viewCenter = viewMatrix * (modelMatrix * vmath::vec4(bounds.sphereCenter, 1.0f));
+
+    float scale = 0.0f;
+    for (int i = 0; i < 3; i++) {
+        scale = std::max(scale, vmath::length(vmath::vec3(modelMatrix[i][0], modelMatrix[i][1], modelMatrix[i][2])));
+    }
+    float radius = bounds.sphereRadius * scale;
+    float distance = -viewCenter[2];
+
+    // Camera inside the sphere: it can cover the whole view
+    if (distance <= radius) {
+        return (float)windowHeight;
+    }
+    return radius * projMatrix[1][1] / distance * windowHeight;
+}
+
+// Pixels covered by one mesh-space unit at the nearest point of the mesh's bounding sphere
+float Renderer::getPixelsPerUnit(const BoundingVolume& bounds, const vmath::mat4& modelMatrix) const {
+    vmath::vec4 viewCenter = viewMatrix * (modelMatrix * vmath::vec4(bounds.sphereCenter, 1.0f));
+
+    float scale = 0.0f;
+    for (int i = 0; i < 3; i++) {
+        scale = std::max(scale, vmath::length(vmath::vec3(modelMatrix[i][0], modelMatrix[i][1], modelMatrix[i][2])));
+    }
+    float nearest = -viewCenter[2] - bounds.sphereRadius * scale;
+
+    // Camera inside the sphere: only level 0 is safe
+    if (nearest <= 0.0f) {
+        return FLT_MAX;
+    }
+    return scale * projMatrix[1][1] * 0.5f * windowHeight / nearest;
+}
+
+void Renderer::renderDirect(double currentTime) {
+    vmath::mat4 animationMatrix = vmath::rotate<float>(0.0f, 60.0f * currentTime, 0.0f);
+    cullMeshes(animationMatrix, visibleMeshes);
+
     glUseProgram(texturedShaderProgram);
     glUniformMatrix4fv(projLocation, 1, GL_FALSE, projMatrix);
     glUniformMatrix4fv(viewLocation, 1, GL_FALSE, viewMatrix);
 
-    // Draw gameObject
-    for (Mesh mesh : gameObject.meshes) {
-        mesh.modelMatrix *= vmath::rotate<float>(0.0f, 60.0f * currentTime, 0.0f);
-        glUniformMatrix4fv(modelLocation, 1, GL_FALSE, mesh.modelMatrix);
+    // Set lighting uniforms
+    glUniform3fv(lightDirectionLocation, 1, lightDirection);
+    glUniform3fv(lightColorLocation, 1, lightColor);
+    glUniform3fv(viewPosLocation, 1, cameraPosition);
+
+    // Textures and the material table are bound once; each mesh only selects its material index
+    int bindCount = materialSystem.bind(textureArraysLocation);
+
+    instanceBuffer.bind();
+    profiler.addCount(Profiler::Counter_StateChanges, bindCount + 2); // + program and instances
+
+    // Every mesh lives in the shared arena, so the VAO only changes with the index type
+    GLenum boundIndexType = GL_NONE;
+    for (const Mesh* visibleMesh : visibleMeshes) {
+        const Mesh& mesh = *visibleMesh;
+
+        if (mesh.geometry.indexType != boundIndexType) {
+            boundIndexType = mesh.geometry.indexType;
+            glBindVertexArray(geometryArena.getVAO(boundIndexType));
+            profiler.addCount(Profiler::Counter_StateChanges, 1);
+        }
+
+        vmath::mat4 modelMatrix = mesh.modelMatrix * animationMatrix;
+        glUniformMatrix4fv(modelLocation, 1, GL_FALSE, modelMatrix);
+        glUniform1ui(materialIndexLocation, mesh.materialIndex);
+        glUniform1ui(firstInstanceLocation, mesh.firstInstance);
+        glUniform4fv(positionDequantLocation, 1, mesh.positionDequant);
+
+        // Draw the selected level's sub-range of the arena once per instance
+        const MeshLod& lod = mesh.lods[mesh.lod];
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, lod.indexCount, mesh.geometry.indexType,
+            (void*)((size_t)(mesh.geometry.firstIndex + lod.firstIndex) * GeometryArena::getIndexSize(mesh.geometry.indexType)), mesh.instanceCount, mesh.geometry.baseVertex);
+
+        profiler.addCount(Profiler::Counter_DrawCalls, 1);
+        profiler.addCount(Profiler::Counter_Triangles, (unsigned long long)(lod.indexCount / 3) * mesh.instanceCount);
+    }
+
+    glBindVertexArray(0);
+}
+
+void Renderer::renderIndirect(double currentTime) {
+    vmath::mat4 animationMatrix = vmath::rotate<float>(0.0f, 60.0f * currentTime, 0.0f);
+
+    // Commands only change when the visible set does (streaming, load/unload, or the view moving)
+    cullMeshes(animationMatrix, visibleMeshes);
+    if (indirectDirty || visibleMeshes != indirectVisibleMeshes) {
+        indirectVisibleMeshes.swap(visibleMeshes);
+        buildIndirectDraws();
+    }
+
+    submitIndirectDraws(animationMatrix);
+}
+
+// Draws the command and draw data buffers with the indirect program
+void Renderer::submitIndirectDraws(const vmath::mat4& animationMatrix) {
+    glUseProgram(indirectShaderProgram);
+    glUniformMatrix4fv(indirectProjLocation, 1, GL_FALSE, projMatrix);
+    glUniformMatrix4fv(indirectViewLocation, 1, GL_FALSE, viewMatrix);
+    glUniformMatrix4fv(indirectAnimationLocation, 1, GL_FALSE, animationMatrix);
+
+    // Set lighting uniforms
+    glUniform3fv(indirectLightDirectionLocation, 1, lightDirection);
+    glUniform3fv(indirectLightColorLocation, 1, lightColor);
+    glUniform3fv(indirectViewPosLocation, 1, cameraPosition);
+
+    int bindCount = materialSystem.bind(indirectTextureArraysLocation);
+
+    // Materials come from the GPU table, so the whole scene is one multi-draw per index type
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, drawCommandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, drawDataBuffer);
+    instanceBuffer.bind();
+    profiler.addCount(Profiler::Counter_StateChanges, bindCount + 4); // + program, command, draw data and instance buffers
+
+    // 16-bit commands come first; the draw offset keeps gl_DrawIDARB pointing at the right DrawData
+    const GLenum indexTypes[] = { GL_UNSIGNED_SHORT, GL_UNSIGNED_INT };
+    const GLsizei drawCounts[] = { indirectShortDrawCount, indirectDrawCount - indirectShortDrawCount };
+    GLsizei drawOffset = 0;
+    for (int i = 0; i < 2; i++) {
+        if (drawCounts[i] > 0) {
+            glBindVertexArray(geometryArena.getVAO(indexTypes[i]));
+            glUniform1ui(indirectDrawOffsetLocation, (GLuint)drawOffset);
+            glMultiDrawElementsIndirect(GL_TRIANGLES, indexTypes[i], (void*)((size_t)drawOffset * sizeof(DrawElementsIndirectCommand)), drawCounts[i], 0);
+            profiler.addCount(Profiler::Counter_StateChanges, 1);
+            profiler.addCount(Profiler::Counter_DrawCalls, 1);
+        }
+        drawOffset += drawCounts[i];
+    }
+    profiler.addCount(Profiler::Counter_Triangles, indirectTriangleCount);
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+// Packs every visible mesh into an indirect command + per-draw SSBO entry
+void Renderer::buildIndirectDraws() {
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<DrawData> drawData;
+    indirectTriangleCount = 0;
+    indirectShortDrawCount = 0;
+
+    for (const Mesh* visibleMesh : indirectVisibleMeshes) {
+        const Mesh& mesh = *visibleMesh;
+
+        const MeshLod& lod = mesh.lods[mesh.lod];
+        DrawElementsIndirectCommand command;
+        command.count = lod.indexCount;
+        command.instanceCount = mesh.instanceCount;
+        command.firstIndex = mesh.geometry.firstIndex + lod.firstIndex;
+        command.baseVertex = (GLint)mesh.geometry.baseVertex;
+        command.baseInstance = 0;
+        commands.push_back(command);
+        indirectTriangleCount += (unsigned long long)(command.count / 3) * command.instanceCount;
+        if (mesh.geometry.indexType == GL_UNSIGNED_SHORT) {
+            indirectShortDrawCount++;
+        }
+
+        DrawData draw;
+        draw.modelMatrix = mesh.modelMatrix;
+        draw.positionDequant = mesh.positionDequant;
+        draw.materialIndex = mesh.materialIndex;
+        draw.firstInstance = mesh.firstInstance;
+        draw.padding[0] = draw.padding[1] = 0;
+        drawData.push_back(draw);
+    }
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, drawCommandBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawDataBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, drawData.size() * sizeof(DrawData), drawData.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    indirectDrawCount = (GLsizei)commands.size();
+    indirectDirty = false;
+}
+
+void Renderer::renderMeshlets(double currentTime) {
+    vmath::mat4 animationMatrix = vmath::rotate<float>(0.0f, 60.0f * currentTime, 0.0f);
+
+    // Whole meshes are culled and given a level first; only what survives is split up
+    cullMeshes(animationMatrix, visibleMeshes);
+    {
+        ProfileScope scope(profiler, meshletZone);
+        buildMeshletDraws(animationMatrix);
+    }
+
+    submitIndirectDraws(animationMatrix);
+}
+
+// Every visible instance of a visible mesh drawn at level 0 has its meshlets culled on the pool,
+// and each run of surviving meshlets becomes a command. Meshes at coarser levels are drawn whole,
+// as in the indirect path. The buffers are rebuilt every frame.
+void Renderer::buildMeshletDraws(const vmath::mat4& animationMatrix) {
+    Frustum frustum;
+    frustum.extract(projMatrix * viewMatrix);
+
+    if (meshletDraws.size() < visibleMeshes.size()) {
+        meshletDraws.resize(visibleMeshes.size());
+    }
+
+    threadPool.parallelFor(visibleMeshes.size(), [&](size_t i) {
+        const Mesh& mesh = *visibleMeshes[i];
+        MeshletDraws& draws = meshletDraws[i];
+        draws.ranges.clear();
+        draws.commands.clear();
+        draws.drawData.clear();
+        draws.culled = 0;
+
+        DrawData draw;
+        draw.modelMatrix = mesh.modelMatrix;
+        draw.positionDequant = mesh.positionDequant;
+        draw.materialIndex = mesh.materialIndex;
+        draw.firstInstance = mesh.firstInstance;
+        draw.padding[0] = draw.padding[1] = 0;
+
+        DrawElementsIndirectCommand command;
+        command.baseVertex = (GLint)mesh.geometry.baseVertex;
+        command.baseInstance = 0;
+
+        if (mesh.lod != 0 || mesh.meshlets.empty()) {
+            const MeshLod& lod = mesh.lods[mesh.lod];
+            command.count = lod.indexCount;
+            command.instanceCount = mesh.instanceCount;
+            command.firstIndex = mesh.geometry.firstIndex + lod.firstIndex;
+            draws.commands.push_back(command);
+            draws.drawData.push_back(draw);
+            return;
+        }
+
+        vmath::mat4 meshMatrix = mesh.modelMatrix * animationMatrix;
+        command.instanceCount = 1;
+        for (unsigned int instance = mesh.firstInstance; instance < mesh.firstInstance + mesh.instanceCount; instance++) {
+            size_t firstRange = draws.ranges.size();
+            draws.culled += Meshlets::cull(mesh.meshlets, instanceBuffer.getTransform(instance) * meshMatrix, frustum, cameraPosition, draws.ranges);
+
+            draw.firstInstance = instance;
+            for (size_t range = firstRange; range < draws.ranges.size(); range++) {
+                command.count = draws.ranges[range].indexCount;
+                command.firstIndex = mesh.geometry.firstIndex + draws.ranges[range].firstIndex;
+                draws.commands.push_back(command);
+                draws.drawData.push_back(draw);
+            }
+        }
+    });
+
+    // Meshes are in cullMeshes' order, so the 16-bit commands still come first
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<DrawData> drawData;
+    size_t culledMeshlets = 0;
+    indirectTriangleCount = 0;
+    indirectShortDrawCount = 0;
+    for (size_t i = 0; i < visibleMeshes.size(); i++) {
+        const MeshletDraws& draws = meshletDraws[i];
+        commands.insert(commands.end(), draws.commands.begin(), draws.commands.end());
+        drawData.insert(drawData.end(), draws.drawData.begin(), draws.drawData.end());
+        culledMeshlets += draws.culled;
+
+        for (const DrawElementsIndirectCommand& command : draws.commands) {
+            indirectTriangleCount += (unsigned long long)(command.count / 3) * command.instanceCount;
+        }
+        if (visibleMeshes[i]->geometry.indexType == GL_UNSIGNED_SHORT) {
+            indirectShortDrawCount += (GLsizei)draws.commands.size();
+        }
+    }
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, drawCommandBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawDataBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, drawData.size() * sizeof(DrawData), drawData.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    indirectDrawCount = (GLsizei)commands.size();
+    profiler.addCount(Profiler::Counter_UploadBytes, commands.size() * sizeof(DrawElementsIndirectCommand) + drawData.size() * sizeof(DrawData));
+    profiler.addCount(Profiler::Counter_CulledMeshlets, culledMeshlets);
+
+    // The indirect path has to rebuild its own commands when it comes back
+    indirectDirty = true;
+}
+
+void Renderer::renderGpuCulled(double currentTime) {
+    vmath::mat4 animationMatrix = vmath::rotate<float>(0.0f, 60.0f * currentTime, 0.0f);
+
+    // Records only change with the scene's structure, never with the view
+    if (cullRecordsDirty) {
+        buildCullRecords();
+    }
+
+    // Statistics and texture sizes come from a frame the GPU already finished
+    GpuCulling::Feedback feedback;
+    if (gpuCulling.takeFeedback(feedback)) {
+        profiler.addCount(Profiler::Counter_Triangles, feedback.triangles);
+        profiler.addCount(Profiler::Counter_CulledMeshes, feedback.culledRecords);
+        for (GLuint materialId = 0; materialId < feedback.materialSizes.size(); materialId++) {
+            if (feedback.materialSizes[materialId] > 0.0f) {
+                textureResidency.requestMaterial(materialId, feedback.materialSizes[materialId]);
+            }
+        }
+    }
+
+    Frustum frustum;
+    frustum.extract(projMatrix * viewMatrix);
+    instanceBuffer.bind();
+    gpuCulling.cull(frustum, viewMatrix, animationMatrix, projMatrix[1][1] * windowHeight, (float)windowHeight,
+        materialSystem.getMaterialCount());
+
+    glUseProgram(culledShaderProgram);
+    glUniformMatrix4fv(culledProjLocation, 1, GL_FALSE, projMatrix);
+    glUniformMatrix4fv(culledViewLocation, 1, GL_FALSE, viewMatrix);
+    glUniformMatrix4fv(culledAnimationLocation, 1, GL_FALSE, animationMatrix);
 
-        // Set lighting uniforms
-        glUniform3fv(lightDirectionLocation, 1, lightDirection);
-        glUniform3fv(lightColorLocation, 1, lightColor);
-        glUniform3fv(viewPosLocation, 1, cameraPosition);
+    // Set lighting uniforms
+    glUniform3fv(culledLightDirectionLocation, 1, lightDirection);
+    glUniform3fv(culledLightColorLocation, 1, lightColor);
+    glUniform3fv(culledViewPosLocation, 1, cameraPosition);
 
-        // Bind textures
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, mesh.material.diffuseTextureId);
-        glUniform1i(diffuseSamplerLocation, 0);
-        glUniform1i(matValidityCheckLocation, mesh.material.diffuseTextureId == -1 ? 0 : 1);
+    int bindCount = materialSystem.bind(culledTextureArraysLocation);
 
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, mesh.material.normalTextureId);
-        glUniform1i(normalSamplerLocation, 1);
+    int drawCount = gpuCulling.draw(geometryArena, culledDrawOffsetLocation, bindCount);
+    profiler.addCount(Profiler::Counter_StateChanges, bindCount + 3); // + compute and draw programs and instances
+    profiler.addCount(Profiler::Counter_DrawCalls, drawCount);
+
+    glBindVertexArray(0);
+}
+
+// One record per drawable mesh, 16-bit meshes first; meshes still streaming in keep the records
+// dirty until they land
+void Renderer::buildCullRecords() {
+    std::vector<GpuCulling::DrawRecord> records;
+    std::vector<GpuCulling::DrawRecord> wideRecords;
+    cullRecordsDirty = false;
+
+    for (const GameObject& object : gameObjects) {
+        for (const Mesh& mesh : object.meshes) {
+            if (mesh.geometry.indexCount == 0 || mesh.instanceCount == 0) {
+                continue;
+            }
+            if (!uploadRing.isSubmitted(mesh.uploadTicket)) {
+                cullRecordsDirty = true;
+                continue;
+            }
 
-        // Bind the VAO and draw the mesh
-        glBindVertexArray(mesh.VAO);
-        glDrawElements(GL_TRIANGLES, mesh.indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+            GpuCulling::DrawRecord record;
+            record.modelMatrix = mesh.modelMatrix;
+            record.sphere = vmath::vec4(mesh.bounds.sphereCenter[0], mesh.bounds.sphereCenter[1], mesh.bounds.sphereCenter[2], mesh.bounds.sphereRadius);
+            record.positionDequant = mesh.positionDequant;
+            record.baseVertex = (GLint)mesh.geometry.baseVertex;
+            record.materialIndex = mesh.materialIndex;
+            record.firstInstance = mesh.firstInstance;
+            record.instanceCount = mesh.instanceCount;
+            record.outputOffset = 0;
+            record.wideIndices = mesh.geometry.indexType == GL_UNSIGNED_INT ? 1 : 0;
+
+            // The shader picks the level each frame, starting from the CPU's last pick
+            record.lodCount = (GLuint)mesh.lodCount;
+            record.lod = (GLuint)mesh.lod;
+            for (int i = 0; i < kMaxLods; i++) {
+                bool used = i < mesh.lodCount;
+                record.lodFirstIndex[i] = used ? mesh.geometry.firstIndex + mesh.lods[i].firstIndex : 0;
+                record.lodIndexCount[i] = used ? mesh.lods[i].indexCount : 0;
+                record.lodError[i] = used ? mesh.lods[i].error : 0.0f;
+            }
+            record.padding = 0;
+            (record.wideIndices ? wideRecords : records).push_back(record);
+        }
     }
+    records.insert(records.end(), wideRecords.begin(), wideRecords.end());
+
+    gpuCulling.setRecords(records);
 }
 
 void Renderer::loadShaders(std::string shaderName, GLuint& programId)
+{
+    loadShaders(shaderName, shaderName, programId);
+}
+
+void Renderer::loadShaders(std::string vertexShaderName, std::string fragmentShaderName, GLuint& programId)
 {
     GLuint vertex_shader;
     GLuint fragment_shader;
 
-    vertex_shader = ES::LoadShader(("shaders/" + shaderName + ".vs.glsl").c_str(), GL_VERTEX_SHADER);
-    fragment_shader = ES::LoadShader(("shaders/" + shaderName + ".fs.glsl").c_str(), GL_FRAGMENT_SHADER);
+    vertex_shader = ES::LoadShader(("shaders/" + vertexShaderName + ".vs.glsl").c_str(), GL_VERTEX_SHADER);
+    fragment_shader = ES::LoadShader(("shaders/" + fragmentShaderName + ".fs.glsl").c_str(), GL_FRAGMENT_SHADER);
 
     programId = glCreateProgram();
     glAttachShader(programId, vertex_shader);
@@ -125,163 +1025,367 @@ void Renderer::loadShaders(std::string shaderName, GLuint& programId)
     glDeleteShader(fragment_shader);
 }
 
-GameObject Renderer::loadModel(const std::string& path) {
-    Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_JoinIdenticalVertices);
-    GameObject gameObject;
+// Cache read or full import; runs on a worker thread, so no GL and no shared state
+bool Renderer::loadModelData(const std::string& path, ModelData& modelData) {
+    // Prefer the pre-baked cache; fall back to Assimp and bake a fresh cache on a miss
+    MeshCache::Key cacheKey;
+    bool hasKey = MeshCache::computeKey(path, MeshImport::kImportFlags, cacheKey);
+    std::string cachePath = MeshCache::getCachePath(path);
 
-    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
-        OutputDebugStringA("Error loading model");
-        return gameObject;
-    }
+    if (!hasKey || !MeshCache::load(cachePath, cacheKey, modelData)) {
+        if (!importModel(path, modelData)) {
+            return false;
+        }
 
-    currentModelTextureIds.clear();
-    processNode(scene->mRootNode, scene, gameObject);
+        if (hasKey) {
+            MeshCache::save(cachePath, cacheKey, modelData);
+        }
+    }
 
-    return gameObject;
-}
+    // The cache holds the meshes as imported, so every setting loads from the same file
+    if (geometrySettings.shortIndicesOnly) {
+        splitMeshes(modelData);
+    }
 
-void Renderer::processNode(aiNode* node, const aiScene* scene, GameObject& gameObject) {
-    // The local transformation of the current node
-    aiMatrix4x4 t = node->mTransformation;
+    // 16-bit indices are picked per mesh by the geometry arena
+    size_t shortMeshes = 0;
+    size_t indexBytes = 0;
+    size_t wideIndexBytes = 0;
+    for (const MeshData& mesh : modelData.meshes) {
+        GLenum indexType = GeometryArena::selectIndexType((unsigned int)(mesh.vertices.size() / MeshImport::kFloatsPerVertex));
+        shortMeshes += indexType == GL_UNSIGNED_SHORT ? 1 : 0;
+        indexBytes += mesh.indices.size() * GeometryArena::getIndexSize(indexType);
+        wideIndexBytes += mesh.indices.size() * sizeof(unsigned int);
+    }
+    char message[256];
+    snprintf(message, sizeof(message), "\n%s: 16-bit indices for %zu of %zu meshes, index memory %zu KB instead of %zu KB (%zu KB saved)",
+        path.c_str(), shortMeshes, modelData.meshes.size(), indexBytes >> 10, wideIndexBytes >> 10, (wideIndexBytes - indexBytes) >> 10);
+    OutputDebugStringA(message);
 
-    // Iterate over all the meshes that this node references
-    for (unsigned int i = 0; i < node->mNumMeshes; i++) {
-        aiMesh* inputMesh = scene->mMeshes[node->mMeshes[i]];
-        Mesh outputMesh;
-        outputMesh.modelMatrix = getGlobalTransform(node, scene);
+    if (geometrySettings.vertexLayout == VertexQuantization::VertexLayout_Compact) {
+        quantizeMeshes(path, modelData);
+    }
 
-        float s = 28.0f;
-        outputMesh.modelMatrix = vmath::translate(0.0f, -1.1f, 0.0f) * vmath::scale(s,s,s) * vmath::rotate(0.0f, 0.0f, 0.0f) * outputMesh.modelMatrix;
+    return true;
+}
 
-        processMesh(inputMesh, outputMesh);
+// Replaces every mesh too large for 16-bit indices with parts that fit. Parts are split from
+// level 0 and get LOD chains and meshlets of their own.
+void Renderer::splitMeshes(ModelData& modelData) {
+    std::vector<MeshData> meshes;
+    meshes.reserve(modelData.meshes.size());
+    for (MeshData& mesh : modelData.meshes) {
+        if (mesh.vertices.size() / MeshImport::kFloatsPerVertex <= GeometryArena::kMaxShortIndexVertices) {
+            meshes.push_back(std::move(mesh));
+            continue;
+        }
 
-        // Load texture
-        if (inputMesh->mMaterialIndex >= 0) {
-            aiMaterial* material = scene->mMaterials[inputMesh->mMaterialIndex];
-            outputMesh.material.diffuseTextureId = loadEmbededTexture(material, scene, aiTextureType_DIFFUSE);
-            outputMesh.material.normalTextureId = loadEmbededTexture(material, scene, aiTextureType_NORMALS);
+        if (!mesh.lods.empty()) {
+            mesh.indices.resize(mesh.lods[0].indexCount);
         }
 
-        gameObject.meshes.push_back(outputMesh);
+        std::vector<MeshData> parts;
+        MeshImport::splitMesh(mesh, GeometryArena::kMaxShortIndexVertices, parts);
+        for (MeshData& part : parts) {
+            meshes.push_back(std::move(part));
+        }
     }
+    modelData.meshes.swap(meshes);
 
-    // Recursively process each child node
-    for (unsigned int i = 0; i < node->mNumChildren; i++) {
-        processNode(node->mChildren[i], scene, gameObject);
+    threadPool.parallelFor(modelData.meshes.size(), [&](size_t i) {
+        if (modelData.meshes[i].lods.empty()) {
+            LevelOfDetail::buildLods(modelData.meshes[i]);
+            Meshlets::build(modelData.meshes[i]);
+        }
+    });
+}
+
+// Packs every mesh into the compact layout and reports how far it is from the float data
+void Renderer::quantizeMeshes(const std::string& path, ModelData& modelData) {
+    std::vector<VertexQuantization::Error> errors(modelData.meshes.size());
+    threadPool.parallelFor(modelData.meshes.size(), [&](size_t i) {
+        MeshData& mesh = modelData.meshes[i];
+        errors[i] = VertexQuantization::quantize(mesh.vertices, mesh.indices, mesh.packedVertices, mesh.positionDequant);
+    });
+
+    for (size_t i = 0; i < errors.size(); i++) {
+        const VertexQuantization::Error& error = errors[i];
+        char message[256];
+        snprintf(message, sizeof(message), "\n%s mesh %zu: %zu vertices, position error %g (%.4f%% of extent), normal %.3f deg, tangent %.3f deg, uv %g",
+            path.c_str(), i, modelData.meshes[i].vertices.size() / MeshImport::kFloatsPerVertex, error.position,
+            error.positionRelative * 100.0f, error.normalDegrees, error.tangentDegrees, error.texCoord);
+        OutputDebugStringA(message);
+
+        // Only the packed copy is uploaded
+        std::vector<float>().swap(modelData.meshes[i].vertices);
     }
 }
 
-void Renderer::processMesh(aiMesh* aiInputMesh, Mesh& outputMesh) {
-    // Iterate over the vertices of the mesh
-    for (unsigned int i = 0; i < aiInputMesh->mNumVertices; i++) {
+bool Renderer::importModel(const std::string& path, ModelData& modelData) {
+    Assimp::Importer importer;
+    const aiScene* scene = importer.ReadFile(path, MeshImport::kImportFlags);
+
+    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+        OutputDebugStringA("Error loading model");
+        return false;
+    }
 
-        // Vertex positions
-        outputMesh.vertices.push_back(aiInputMesh->mVertices[i].x);
-        outputMesh.vertices.push_back(aiInputMesh->mVertices[i].y);
-        outputMesh.vertices.push_back(aiInputMesh->mVertices[i].z);
+    // Walk the hierarchy first; it only records what to convert, so it stays cheap and serial
+    ImportSources sources;
+    processNode(scene->mRootNode, scene, modelData, -1, sources);
+
+    // Identical embedded files under different paths are decoded once; the hash also lets
+    // MaterialSystem share the GPU copy with other models
+    const size_t textureCount = sources.textures.size();
+    std::vector<unsigned long long> contentHashes(textureCount);
+    std::vector<size_t> canonical(textureCount);
+    std::map<unsigned long long, size_t> firstWithHash;
+    for (size_t i = 0; i < textureCount; i++) {
+        const aiTexture* texture = sources.textures[i];
+        contentHashes[i] = MeshCache::hashBytes(reinterpret_cast<const unsigned char*>(texture->pcData), texture->mWidth);
+        canonical[i] = firstWithHash.insert(std::make_pair(contentHashes[i], i)).first->second;
+    }
 
-        // Normals
-        if (aiInputMesh->HasNormals()) {
-            outputMesh.vertices.push_back(aiInputMesh->mNormals[i].x);
-            outputMesh.vertices.push_back(aiInputMesh->mNormals[i].y);
-            outputMesh.vertices.push_back(aiInputMesh->mNormals[i].z);
+    // Texture decodes and mesh conversions are independent, so they all run on the pool.
+    // Textures go first since they are the long tasks.
+    std::vector<unsigned char> decoded(textureCount, 0);
+    std::vector<MeshOptimization::CacheStats> cacheBefore(sources.meshes.size());
+    std::vector<MeshOptimization::CacheStats> cacheAfter(sources.meshes.size());
+    threadPool.parallelFor(textureCount + sources.meshes.size(), [&](size_t task) {
+        if (task < textureCount) {
+            if (canonical[task] == task) {
+                decoded[task] = MeshImport::decodeTexture(sources.textures[task], modelData.textures[task]) ? 1 : 0;
+                modelData.textures[task].contentHash = contentHashes[task];
+            }
         }
         else {
-            outputMesh.vertices.push_back(0.0f);
-            outputMesh.vertices.push_back(0.0f);
-            outputMesh.vertices.push_back(0.0f);
+            size_t mesh = task - textureCount;
+            processMesh(sources.meshes[mesh], modelData.meshes[mesh], cacheBefore[mesh], cacheAfter[mesh]);
         }
+    });
+
+    for (size_t i = 0; i < cacheBefore.size(); i++) {
+        char message[256];
+        snprintf(message, sizeof(message), "\n%s mesh %zu: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f (%u-entry FIFO)",
+            path.c_str(), i, cacheBefore[i].acmr, cacheAfter[i].acmr, cacheBefore[i].atvr, cacheAfter[i].atvr, MeshOptimization::kCacheSize);
+        OutputDebugStringA(message);
+
+        int length = snprintf(message, sizeof(message), "\n%s mesh %zu: %zu meshlets, LOD triangles (error)",
+            path.c_str(), i, modelData.meshes[i].meshlets.size());
+        for (const MeshLod& lod : modelData.meshes[i].lods) {
+            if (length > 0 && length < (int)sizeof(message)) {
+                length += snprintf(message + length, sizeof(message) - length, " %u (%g)", lod.indexCount / 3, lod.error);
+            }
+        }
+        OutputDebugStringA(message);
+    }
 
-        // Tangents
-        if (aiInputMesh->HasTangentsAndBitangents()) {
-            outputMesh.vertices.push_back(aiInputMesh->mTangents[i].x);
-            outputMesh.vertices.push_back(aiInputMesh->mTangents[i].y);
-            outputMesh.vertices.push_back(aiInputMesh->mTangents[i].z);
+    // Drop duplicates and textures that failed to decode, pointing their users at the first
+    // copy or at "no texture"
+    std::vector<int> remap(textureCount, -1);
+    std::vector<TextureData> textures;
+    for (size_t i = 0; i < textureCount; i++) {
+        if (canonical[i] != i) {
+            remap[i] = remap[canonical[i]];
+        }
+        else if (decoded[i]) {
+            remap[i] = (int)textures.size();
+            textures.push_back(std::move(modelData.textures[i]));
         }
         else {
-            outputMesh.vertices.push_back(0.0f);
-            outputMesh.vertices.push_back(0.0f);
-            outputMesh.vertices.push_back(0.0f);
+            OutputDebugStringA("\nFailed to load embedded texture");
         }
+    }
+    modelData.textures.swap(textures);
 
-        // Texture coordinates
-        if (aiInputMesh->mTextureCoords[0]) {
-            outputMesh.vertices.push_back(aiInputMesh->mTextureCoords[0][i].x);
-            outputMesh.vertices.push_back(aiInputMesh->mTextureCoords[0][i].y);
+    for (MeshData& mesh : modelData.meshes) {
+        mesh.diffuseTexture = mesh.diffuseTexture == -1 ? -1 : remap[mesh.diffuseTexture];
+        mesh.normalTexture = mesh.normalTexture == -1 ? -1 : remap[mesh.normalTexture];
+    }
+
+    // Block-compress once here so the cache holds GPU-ready mips. A texture that is also
+    // used as a diffuse map is kept as color.
+    std::vector<unsigned char> isNormalMap(modelData.textures.size(), 0);
+    for (const MeshData& mesh : modelData.meshes) {
+        if (mesh.normalTexture != -1) {
+            isNormalMap[mesh.normalTexture] = 1;
         }
-        else {
-            outputMesh.vertices.push_back(0.0f);
-            outputMesh.vertices.push_back(0.0f);
+    }
+    for (const MeshData& mesh : modelData.meshes) {
+        if (mesh.diffuseTexture != -1) {
+            isNormalMap[mesh.diffuseTexture] = 0;
         }
     }
 
-    // Indices
-    for (unsigned int i = 0; i < aiInputMesh->mNumFaces; i++) {
-        aiFace face = aiInputMesh->mFaces[i];
-        for (unsigned int j = 0; j < face.mNumIndices; j++) {
-            outputMesh.indices.push_back(face.mIndices[j]);
+    threadPool.parallelFor(modelData.textures.size(), [&](size_t i) {
+        TextureData& texture = modelData.textures[i];
+        TextureFormat format = isNormalMap[i] ? TextureFormat_BC5
+            : TextureCompression::isOpaque(texture) ? TextureFormat_BC1 : TextureFormat_BC7;
+        TextureCompression::compress(texture, format);
+    });
+
+    return true;
+}
+
+// Appends the node (pre-order, so parents come first) and the meshes it references
+void Renderer::processNode(aiNode* node, const aiScene* scene, ModelData& modelData, int parent, ImportSources& sources) {
+    aiVector3D scaling;
+    aiQuaternion rotation;
+    aiVector3D position;
+    node->mTransformation.Decompose(scaling, rotation, position);
+
+    NodeData nodeData;
+    nodeData.parent = parent;
+    nodeData.translation = vmath::vec3(position.x, position.y, position.z);
+    nodeData.rotation = vmath::vec4(rotation.x, rotation.y, rotation.z, rotation.w);
+    nodeData.scale = vmath::vec3(scaling.x, scaling.y, scaling.z);
+
+    int nodeIndex = (int)modelData.nodes.size();
+    modelData.nodes.push_back(nodeData);
+
+    // Iterate over all the meshes that this node references
+    for (unsigned int i = 0; i < node->mNumMeshes; i++) {
+        aiMesh* inputMesh = scene->mMeshes[node->mMeshes[i]];
+        MeshData outputMesh;
+        outputMesh.node = nodeIndex;
+        outputMesh.diffuseTexture = -1;
+        outputMesh.normalTexture = -1;
+
+        // Texture slots are reserved now and decoded later on the pool
+        if (inputMesh->mMaterialIndex >= 0) {
+            aiMaterial* material = scene->mMaterials[inputMesh->mMaterialIndex];
+            outputMesh.diffuseTexture = loadEmbededTexture(material, scene, aiTextureType_DIFFUSE, modelData, sources);
+            outputMesh.normalTexture = loadEmbededTexture(material, scene, aiTextureType_NORMALS, modelData, sources);
         }
+
+        modelData.meshes.push_back(std::move(outputMesh));
+        sources.meshes.push_back(inputMesh);
     }
 
-    // Generate OpenGL buffers and arrays
-    glGenVertexArrays(1, &outputMesh.VAO);
-    glGenBuffers(1, &outputMesh.VBO);
-    glGenBuffers(1, &outputMesh.EBO);
+    // Recursively process each child node
+    for (unsigned int i = 0; i < node->mNumChildren; i++) {
+        processNode(node->mChildren[i], scene, modelData, nodeIndex, sources);
+    }
+}
 
-    // Bind and fill data in buffers
-    glBindVertexArray(outputMesh.VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, outputMesh.VBO);
-    glBufferData(GL_ARRAY_BUFFER, outputMesh.vertices.size() * sizeof(float), &outputMesh.vertices[0], GL_STATIC_DRAW);
+// Runs on a pool thread
+void Renderer::processMesh(const aiMesh* aiInputMesh, MeshData& outputMesh,
+    MeshOptimization::CacheStats& cacheBefore, MeshOptimization::CacheStats& cacheAfter) {
+    // Interleaved vertices and indices, sized once and filled by an attribute-specialized kernel
+    MeshImport::fillVertices(aiInputMesh, outputMesh.vertices);
+    MeshImport::fillIndices(aiInputMesh, outputMesh.indices);
+
+    // Triangle and vertex order are tuned for the GPU's caches once here and kept in the MeshCache
+    const int stride = MeshImport::kFloatsPerVertex;
+    cacheBefore = MeshOptimization::analyzeVertexCache(outputMesh.indices, outputMesh.vertices.size() / stride);
+    MeshOptimization::optimizeTriangleOrder(outputMesh.indices, outputMesh.vertices, stride);
+    MeshOptimization::optimizeVertexFetch(outputMesh.vertices, stride, outputMesh.indices);
+    cacheAfter = MeshOptimization::analyzeVertexCache(outputMesh.indices, outputMesh.vertices.size() / stride);
+
+    outputMesh.bounds = computeBounds(outputMesh.vertices, MeshImport::kFloatsPerVertex);
+
+    // Coarser levels are appended to the optimized indices and share its vertices
+    LevelOfDetail::buildLods(outputMesh);
+    Meshlets::build(outputMesh);
+}
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, outputMesh.EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, outputMesh.indices.size() * sizeof(unsigned int), &outputMesh.indices[0], GL_STATIC_DRAW);
+GameObject Renderer::createGameObject(ModelData& modelData) {
+    GameObject gameObject;
 
-    GLsizei stride = (3 + 3 + 3 + 2) * sizeof(float);
+    // Textures are queued first, so a mesh's own ticket also covers the textures it uses
+    gameObject.textureIds = materialSystem.addTextures(modelData.textures);
+    textureResidency.addTextures(gameObject.textureIds);
 
-    // Specify the layout of the vertex data
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
-    glEnableVertexAttribArray(0);
+    // The object's placement is a root node above the model's own hierarchy
+    float s = 28.0f;
+    gameObject.rootNode = sceneGraph.addNode(-1, vmath::vec3(0.0f, -1.1f, 0.0f), vmath::vec4(0.0f, 0.0f, 0.0f, 1.0f), vmath::vec3(s, s, s));
+    for (const NodeData& node : modelData.nodes) {
+        SceneGraph::Node parent = node.parent == -1 ? gameObject.rootNode : gameObject.rootNode + 1 + node.parent;
+        sceneGraph.addNode(parent, node.translation, node.rotation, node.scale);
+    }
+    gameObject.nodeCount = (int)modelData.nodes.size() + 1;
+    sceneGraph.update();
 
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+    // A single identity instance until setInstances says otherwise
+    if (instanceBuffer.allocate(1, gameObject.firstInstance)) {
+        gameObject.instanceCount = 1;
+    }
 
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
+    // One material per distinct diffuse/normal pair in the model
+    std::map<std::pair<int, int>, GLuint> materialIds;
+
+    for (MeshData& meshData : modelData.meshes) {
+        Mesh mesh;
+
+        mesh.node = gameObject.rootNode + 1 + meshData.node;
+        mesh.modelMatrix = sceneGraph.getWorldMatrix(mesh.node);
+        mesh.bounds = meshData.bounds;
+        mesh.positionDequant = geometrySettings.vertexLayout == VertexQuantization::VertexLayout_Compact ? meshData.positionDequant : vmath::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        mesh.firstInstance = gameObject.firstInstance;
+        mesh.instanceCount = gameObject.instanceCount;
+
+        std::pair<int, int> textures(meshData.diffuseTexture, meshData.normalTexture);
+        if (materialIds.find(textures) == materialIds.end()) {
+            int diffuseTextureId = meshData.diffuseTexture == -1 ? -1 : gameObject.textureIds[meshData.diffuseTexture];
+            int normalTextureId = meshData.normalTexture == -1 ? -1 : gameObject.textureIds[meshData.normalTexture];
+            GLuint materialId = materialSystem.addMaterial(diffuseTextureId, normalTextureId);
+            materialIds[textures] = materialId;
+            gameObject.materialIds.push_back(materialId);
+        }
+        mesh.materialIndex = materialIds[textures];
 
-    glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, stride, (void*)(9 * sizeof(float)));
-    glEnableVertexAttribArray(3);
+        uploadMesh(meshData, mesh);
 
-    glBindVertexArray(0);
+        gameObject.meshes.push_back(std::move(mesh));
+    }
+
+    return gameObject;
 }
 
-vmath::mat4 Renderer::getGlobalTransform(aiNode* node, const aiScene* scene) {
-    aiMatrix4x4 t = node->mTransformation;
-    aiNode* parent = node->mParent;
+void Renderer::uploadMesh(const MeshData& meshData, Mesh& mesh) {
+    bool compact = geometrySettings.vertexLayout == VertexQuantization::VertexLayout_Compact;
+    unsigned int vertexCount = compact ? (unsigned int)(meshData.packedVertices.size() / VertexQuantization::kCompactStride)
+        : (unsigned int)(meshData.vertices.size() / MeshImport::kFloatsPerVertex);
+    unsigned int indexCount = (unsigned int)meshData.indices.size();
+
+    if (!geometryArena.allocate(vertexCount, indexCount, mesh.geometry)) {
+        OutputDebugStringA("\nFailed to allocate mesh in geometry arena");
+        mesh.geometry.vertexCount = mesh.geometry.indexCount = 0;
+        mesh.geometry.baseVertex = mesh.geometry.firstIndex = 0;
+        mesh.uploadTicket = 0;
+        return;
+    }
 
-    // Traverse up the hierarchy, multiplying each parent's transform
-    while (parent != nullptr) {
-        t = parent->mTransformation * t;
-        parent = parent->mParent;
+    // Levels index into the mesh's own range; level 0 always exists
+    mesh.lodCount = std::min((int)meshData.lods.size(), kMaxLods);
+    for (int i = 0; i < mesh.lodCount; i++) {
+        mesh.lods[i] = meshData.lods[i];
+    }
+    if (mesh.lodCount == 0) {
+        MeshLod full = { 0, indexCount, 0.0f };
+        mesh.lods[0] = full;
+        mesh.lodCount = 1;
     }
+    mesh.lod = 0;
+    mesh.meshlets = meshData.meshlets;
 
-    return vmath::mat4(vmath::vec4(t.a1, t.b1, t.c1, t.d1),
-        vmath::vec4(t.a2, t.b2, t.c2, t.d2),
-        vmath::vec4(t.a3, t.b3, t.c3, t.d3),
-        vmath::vec4(t.a4, t.b4, t.c4, t.d4));
+    // Contents are streamed in through the upload ring
+    const void* vertices = compact ? (const void*)meshData.packedVertices.data() : (const void*)meshData.vertices.data();
+    mesh.uploadTicket = geometryArena.upload(mesh.geometry, vertices, meshData.indices.data());
 }
 
-// To be used with glb assets only
-GLuint Renderer::loadEmbededTexture(aiMaterial* material, const aiScene* scene, aiTextureType textureType) {
+// To be used with glb assets only. Reserves a modelData.textures slot for the embedded texture and
+// queues its source for decoding; returns the slot index, or -1.
+int Renderer::loadEmbededTexture(aiMaterial* material, const aiScene* scene, aiTextureType textureType, ModelData& modelData, ImportSources& sources) {
     aiString texturePath;
 
     // Try to get a texture of the specified type from the material
     if (material->GetTexture(textureType, 0, &texturePath) == AI_SUCCESS) {
 
         std::string path = texturePath.C_Str();
-        if (currentModelTextureIds.find(path) != currentModelTextureIds.end())
+        if (sources.textureIndices.find(path) != sources.textureIndices.end())
         {
-            return currentModelTextureIds[path];
+            return sources.textureIndices[path];
         }
 
         int textureIndex = std::atoi(&path[1]); // Get texture index
@@ -289,37 +1393,12 @@ GLuint Renderer::loadEmbededTexture(aiMaterial* material, const aiScene* scene,
 
         // Check if the texture is compressed
         if (texture->mHeight == 0) {
-            unsigned char* data = reinterpret_cast<unsigned char*>(texture->pcData);
-            int width, height, nrChannels;
-
-            unsigned char* imageData = stbi_load_from_memory(
-                data, texture->mWidth, &width, &height, &nrChannels, 0);
+            int index = (int)modelData.textures.size();
+            modelData.textures.push_back(TextureData());
+            sources.textures.push_back(texture);
+            sources.textureIndices[path] = index;
 
-            if (imageData) {
-                GLuint textureId;
-                glGenTextures(1, &textureId);
-                glBindTexture(GL_TEXTURE_2D, textureId);
-
-                // Upload the texture to OpenGL
-                if (nrChannels == 3) {
-                    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, imageData);
-                }
-                else if (nrChannels == 4) {
-                    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, imageData);
-                }
-
-                glGenerateMipmap(GL_TEXTURE_2D);
-
-                stbi_image_free(imageData);
-
-                currentModelTextureIds[path] = textureId;
-                allUsedTextureIds.push_back(textureId);
-
-                return textureId;
-            }
-            else {
-                OutputDebugStringA("\nFailed to load embedded texture");
-            }
+            return index;
         }
         else {
             OutputDebugStringA("\nImage is uncompressed (not currently handled)");            
@@ -327,4 +1406,4 @@ GLuint Renderer::loadEmbededTexture(aiMaterial* material, const aiScene* scene,
     }
 
     return -1;
-}
\ No newline at end of file
+}
@@ -0,0 +1,99 @@
+#include "../headers/SceneGraph.h"
+
+SceneGraph::SceneGraph() : firstDirty(0) {
+}
+
+SceneGraph::Node SceneGraph::addNode(Node parent, const vmath::vec3& translation, const vmath::vec4& rotation, const vmath::vec3& scale) {
+    Node node = (Node)parents.size();
+
+    parents.push_back(parent);
+    translations.push_back(translation);
+    rotations.push_back(rotation);
+    scales.push_back(scale);
+    worldMatrices.push_back(vmath::mat4::identity());
+    dirty.push_back(1);
+    updated.push_back(0);
+
+    firstDirty = node < firstDirty ? node : firstDirty;
+    return node;
+}
+
+void SceneGraph::removeNodes(Node first, int count) {
+    if (count <= 0) {
+        return;
+    }
+
+    parents.erase(parents.begin() + first, parents.begin() + first + count);
+    translations.erase(translations.begin() + first, translations.begin() + first + count);
+    rotations.erase(rotations.begin() + first, rotations.begin() + first + count);
+    scales.erase(scales.begin() + first, scales.begin() + first + count);
+    worldMatrices.erase(worldMatrices.begin() + first, worldMatrices.begin() + first + count);
+    dirty.erase(dirty.begin() + first, dirty.begin() + first + count);
+    updated.erase(updated.begin() + first, updated.begin() + first + count);
+
+    for (Node& parent : parents) {
+        if (parent >= first + count) {
+            parent -= count;
+        }
+    }
+
+    // Positions shifted, so the cached start point no longer means anything
+    firstDirty = 0;
+}
+
+void SceneGraph::clear() {
+    removeNodes(0, (int)parents.size());
+}
+
+void SceneGraph::setLocalTransform(Node node, const vmath::vec3& translation, const vmath::vec4& rotation, const vmath::vec3& scale) {
+    translations[node] = translation;
+    rotations[node] = rotation;
+    scales[node] = scale;
+    dirty[node] = 1;
+    firstDirty = node < firstDirty ? node : firstDirty;
+}
+
+int SceneGraph::update() {
+    const Node nodeCount = (Node)parents.size();
+    int updatedCount = 0;
+
+    for (Node node = 0; node < firstDirty && node < nodeCount; node++) {
+        updated[node] = 0;
+    }
+
+    // Parents precede children, so a parent's flag is final by the time its children read it
+    for (Node node = firstDirty; node < nodeCount; node++) {
+        Node parent = parents[node];
+        bool changed = dirty[node] || (parent >= 0 && updated[parent]);
+        updated[node] = changed ? 1 : 0;
+        dirty[node] = 0;
+
+        if (!changed) {
+            continue;
+        }
+
+        vmath::mat4 local = getLocalMatrix(node);
+        worldMatrices[node] = parent >= 0 ? vmath::mat4(worldMatrices[parent] * local) : local;
+        updatedCount++;
+    }
+
+    firstDirty = nodeCount;
+    return updatedCount;
+}
+
+// translate * rotate * scale, built directly rather than through three matrix products
+vmath::mat4 SceneGraph::getLocalMatrix(Node node) const {
+    const vmath::vec3& t = translations[node];
+    const vmath::vec4& q = rotations[node];
+    const vmath::vec3& s = scales[node];
+
+    float xx = q[0] * q[0], yy = q[1] * q[1], zz = q[2] * q[2];
+    float xy = q[0] * q[1], xz = q[0] * q[2], yz = q[1] * q[2];
+    float wx = q[3] * q[0], wy = q[3] * q[1], wz = q[3] * q[2];
+
+    return vmath::mat4(
+        vmath::vec4((1.0f - 2.0f * (yy + zz)) * s[0], 2.0f * (xy + wz) * s[0], 2.0f * (xz - wy) * s[0], 0.0f),
+        vmath::vec4(2.0f * (xy - wz) * s[1], (1.0f - 2.0f * (xx + zz)) * s[1], 2.0f * (yz + wx) * s[1], 0.0f),
+        vmath::vec4(2.0f * (xz + wy) * s[2], 2.0f * (yz - wx) * s[2], (1.0f - 2.0f * (xx + yy)) * s[2], 0.0f),
+        vmath::vec4(t[0], t[1], t[2], 1.0f));
+}
@@ -0,0 +1,356 @@
+#include "../headers/TextureCompression.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+namespace TextureCompression {
+    // BC7 4-bit index interpolation weights, out of 64
+    static const int kBC7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    // Writes fields LSB first into a zeroed block
+    struct BitWriter {
+        unsigned char* block;
+        int position;
+
+        void write(unsigned int value, int bits) {
+            for (int i = 0; i < bits; i++, position++) {
+                if (value & (1u << i)) {
+                    block[position >> 3] |= (unsigned char)(1 << (position & 7));
+                }
+            }
+        }
+    };
+
+    static int clampByte(float value) {
+        return std::min(std::max((int)(value + 0.5f), 0), 255);
+    }
+
+    static int getDistance(const int* a, const int* b, int channels) {
+        int distance = 0;
+        for (int c = 0; c < channels; c++) {
+            distance += (a[c] - b[c]) * (a[c] - b[c]);
+        }
+        return distance;
+    }
+
+    // Palette entry closest to each texel
+    static void findIndices(const unsigned char* texels, int channels, const int (*palette)[4], int paletteSize, int* indices) {
+        for (int i = 0; i < 16; i++) {
+            int texel[4] = { texels[i * 4], texels[i * 4 + 1], texels[i * 4 + 2], texels[i * 4 + 3] };
+            int best = 0;
+            int bestDistance = getDistance(texel, palette[0], channels);
+            for (int p = 1; p < paletteSize; p++) {
+                int distance = getDistance(texel, palette[p], channels);
+                if (distance < bestDistance) {
+                    best = p;
+                    bestDistance = distance;
+                }
+            }
+            indices[i] = best;
+        }
+    }
+
+    // Line through the block's colors along their principal axis (power iteration on the
+    // covariance), cut at the extreme projections
+    static void findEndpoints(const unsigned char* texels, int channels, float* low, float* high) {
+        float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        for (int i = 0; i < 16; i++) {
+            for (int c = 0; c < channels; c++) {
+                mean[c] += texels[i * 4 + c] / 16.0f;
+            }
+        }
+
+        float covariance[4][4] = {};
+        for (int i = 0; i < 16; i++) {
+            for (int a = 0; a < channels; a++) {
+                for (int b = 0; b < channels; b++) {
+                    covariance[a][b] += (texels[i * 4 + a] - mean[a]) * (texels[i * 4 + b] - mean[b]);
+                }
+            }
+        }
+
+        float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        for (int iteration = 0; iteration < 8; iteration++) {
+            float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            float length = 0.0f;
+            for (int a = 0; a < channels; a++) {
+                for (int b = 0; b < channels; b++) {
+                    next[a] += covariance[a][b] * axis[b];
+                }
+                length += next[a] * next[a];
+            }
+            if (length < 1e-6f) {
+                break; // Flat block, any axis works
+            }
+            length = sqrtf(length);
+            for (int c = 0; c < channels; c++) {
+                axis[c] = next[c] / length;
+            }
+        }
+
+        float minProjection = 0.0f;
+        float maxProjection = 0.0f;
+        for (int i = 0; i < 16; i++) {
+            float projection = 0.0f;
+            for (int c = 0; c < channels; c++) {
+                projection += (texels[i * 4 + c] - mean[c]) * axis[c];
+            }
+            minProjection = std::min(minProjection, projection);
+            maxProjection = std::max(maxProjection, projection);
+        }
+
+        for (int c = 0; c < channels; c++) {
+            low[c] = std::min(std::max(mean[c] + axis[c] * minProjection, 0.0f), 255.0f);
+            high[c] = std::min(std::max(mean[c] + axis[c] * maxProjection, 0.0f), 255.0f);
+        }
+    }
+
+    static unsigned short packRGB565(const float* color) {
+        int r = std::min((int)(color[0] * 31.0f / 255.0f + 0.5f), 31);
+        int g = std::min((int)(color[1] * 63.0f / 255.0f + 0.5f), 63);
+        int b = std::min((int)(color[2] * 31.0f / 255.0f + 0.5f), 31);
+        return (unsigned short)((r << 11) | (g << 5) | b);
+    }
+
+    static void unpackRGB565(unsigned short packed, int* color) {
+        int r = (packed >> 11) & 31;
+        int g = (packed >> 5) & 63;
+        int b = packed & 31;
+        color[0] = (r << 3) | (r >> 2);
+        color[1] = (g << 2) | (g >> 4);
+        color[2] = (b << 3) | (b >> 2);
+        color[3] = 255;
+    }
+
+    static void encodeBC1(const unsigned char* texels, unsigned char* block) {
+        float low[3];
+        float high[3];
+        findEndpoints(texels, 3, low, high);
+
+        // color0 > color1 selects the four-color mode
+        unsigned short color0 = packRGB565(high);
+        unsigned short color1 = packRGB565(low);
+        if (color0 < color1) {
+            std::swap(color0, color1);
+        }
+
+        int indices[16] = {};
+        if (color0 != color1) {
+            int palette[4][4];
+            unpackRGB565(color0, palette[0]);
+            unpackRGB565(color1, palette[1]);
+            for (int c = 0; c < 3; c++) {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+            findIndices(texels, 3, palette, 4, indices);
+        }
+
+        unsigned int bits = 0;
+        for (int i = 0; i < 16; i++) {
+            bits |= (unsigned int)indices[i] << (i * 2);
+        }
+
+        block[0] = (unsigned char)(color0 & 0xFF);
+        block[1] = (unsigned char)(color0 >> 8);
+        block[2] = (unsigned char)(color1 & 0xFF);
+        block[3] = (unsigned char)(color1 >> 8);
+        memcpy(block + 4, &bits, sizeof(bits));
+    }
+
+    // One BC4 channel in the eight-value mode (first endpoint greater than the second)
+    static void encodeBC4(const unsigned char* texels, int channel, unsigned char* block) {
+        int low = 255;
+        int high = 0;
+        for (int i = 0; i < 16; i++) {
+            low = std::min(low, (int)texels[i * 4 + channel]);
+            high = std::max(high, (int)texels[i * 4 + channel]);
+        }
+
+        memset(block, 0, 8);
+        block[0] = (unsigned char)high;
+        block[1] = (unsigned char)low;
+        if (high == low) {
+            return;
+        }
+
+        int palette[8] = { high, low };
+        for (int i = 2; i < 8; i++) {
+            palette[i] = ((8 - i) * high + (i - 1) * low) / 7;
+        }
+
+        unsigned long long bits = 0;
+        for (int i = 0; i < 16; i++) {
+            int value = texels[i * 4 + channel];
+            int best = 0;
+            for (int p = 1; p < 8; p++) {
+                if (abs(value - palette[p]) < abs(value - palette[best])) {
+                    best = p;
+                }
+            }
+            bits |= (unsigned long long)best << (i * 3);
+        }
+
+        for (int i = 0; i < 6; i++) {
+            block[2 + i] = (unsigned char)(bits >> (i * 8));
+        }
+    }
+
+    static void encodeBC5(const unsigned char* texels, unsigned char* block) {
+        encodeBC4(texels, 0, block);
+        encodeBC4(texels, 1, block + 8);
+    }
+
+    // Quantizes an endpoint to 7 bits per channel plus the shared p-bit that fits it best
+    static void quantizeBC7Endpoint(const float* color, int* quantized, int& pBit) {
+        int bestError = -1;
+        for (int p = 0; p < 2; p++) {
+            int candidate[4];
+            int error = 0;
+            for (int c = 0; c < 4; c++) {
+                candidate[c] = std::min(std::max((int)((color[c] - p) / 2.0f + 0.5f), 0), 127);
+                int value = (candidate[c] << 1) | p;
+                error += (value - clampByte(color[c])) * (value - clampByte(color[c]));
+            }
+            if (bestError < 0 || error < bestError) {
+                bestError = error;
+                pBit = p;
+                memcpy(quantized, candidate, sizeof(candidate));
+            }
+        }
+    }
+
+    // BC7 mode 6: one subset, RGBA endpoints (7 bits + p-bit) and 4-bit indices
+    static void encodeBC7(const unsigned char* texels, unsigned char* block) {
+        float low[4];
+        float high[4];
+        findEndpoints(texels, 4, low, high);
+
+        int endpoints[2][4];
+        int pBits[2];
+        quantizeBC7Endpoint(low, endpoints[0], pBits[0]);
+        quantizeBC7Endpoint(high, endpoints[1], pBits[1]);
+
+        int palette[16][4];
+        for (int i = 0; i < 16; i++) {
+            for (int c = 0; c < 4; c++) {
+                int e0 = (endpoints[0][c] << 1) | pBits[0];
+                int e1 = (endpoints[1][c] << 1) | pBits[1];
+                palette[i][c] = ((64 - kBC7Weights[i]) * e0 + kBC7Weights[i] * e1 + 32) >> 6;
+            }
+        }
+
+        int indices[16];
+        findIndices(texels, 4, palette, 16, indices);
+
+        // The first index is stored with its top bit implied zero
+        if (indices[0] & 8) {
+            std::swap(endpoints[0], endpoints[1]);
+            std::swap(pBits[0], pBits[1]);
+            for (int i = 0; i < 16; i++) {
+                indices[i] = 15 - indices[i];
+            }
+        }
+
+        memset(block, 0, 16);
+        BitWriter writer = { block, 0 };
+        writer.write(1 << 6, 7);
+        for (int c = 0; c < 4; c++) {
+            writer.write(endpoints[0][c], 7);
+            writer.write(endpoints[1][c], 7);
+        }
+        writer.write(pBits[0], 1);
+        writer.write(pBits[1], 1);
+        writer.write(indices[0], 3);
+        for (int i = 1; i < 16; i++) {
+            writer.write(indices[i], 4);
+        }
+    }
+
+    bool isBlockFormat(TextureFormat format) {
+        return getBlockBytes(format) != 0;
+    }
+
+    size_t getBlockBytes(TextureFormat format) {
+        switch (format) {
+        case TextureFormat_BC1: return 8;
+        case TextureFormat_BC5: return 16;
+        case TextureFormat_BC7: return 16;
+        default: return 0;
+        }
+    }
+
+    size_t getLevelBytes(TextureFormat format, int width, int height) {
+        if (isBlockFormat(format)) {
+            return (size_t)((width + 3) / 4) * ((height + 3) / 4) * getBlockBytes(format);
+        }
+        return (size_t)width * height * (format == TextureFormat_RGBA8 ? 4 : 3);
+    }
+
+    bool isOpaque(const TextureData& texture) {
+        if (texture.channels != 4 || texture.mips.empty()) {
+            return true;
+        }
+
+        const std::vector<unsigned char>& level = texture.mips[0];
+        for (size_t i = 3; i < level.size(); i += 4) {
+            if (level[i] != 255) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void compress(TextureData& texture, TextureFormat format) {
+        if (isBlockFormat(texture.format) || !isBlockFormat(format)) {
+            return;
+        }
+
+        const int channels = texture.channels;
+        const size_t blockBytes = getBlockBytes(format);
+        int width = texture.width;
+        int height = texture.height;
+
+        for (std::vector<unsigned char>& level : texture.mips) {
+            int blocksWide = (width + 3) / 4;
+            int blocksHigh = (height + 3) / 4;
+            std::vector<unsigned char> encoded((size_t)blocksWide * blocksHigh * blockBytes);
+
+            for (int by = 0; by < blocksHigh; by++) {
+                for (int bx = 0; bx < blocksWide; bx++) {
+                    // Gather as RGBA, repeating the last row/column past the edge
+                    unsigned char texels[16 * 4];
+                    for (int y = 0; y < 4; y++) {
+                        int sy = std::min(by * 4 + y, height - 1);
+                        for (int x = 0; x < 4; x++) {
+                            int sx = std::min(bx * 4 + x, width - 1);
+                            const unsigned char* src = &level[((size_t)sy * width + sx) * channels];
+                            unsigned char* dst = &texels[(y * 4 + x) * 4];
+                            dst[0] = src[0];
+                            dst[1] = src[1];
+                            dst[2] = src[2];
+                            dst[3] = channels == 4 ? src[3] : 255;
+                        }
+                    }
+
+                    unsigned char* block = &encoded[((size_t)by * blocksWide + bx) * blockBytes];
+                    if (format == TextureFormat_BC1) {
+                        encodeBC1(texels, block);
+                    }
+                    else if (format == TextureFormat_BC5) {
+                        encodeBC5(texels, block);
+                    }
+                    else {
+                        encodeBC7(texels, block);
+                    }
+                }
+            }
+
+            level.swap(encoded);
+            width = width > 1 ? width / 2 : 1;
+            height = height > 1 ? height / 2 : 1;
+        }
+
+        texture.format = format;
+    }
+}
@@ -0,0 +1,166 @@
+#include "../headers/TextureResidency.h"
+#include <math.h>
+#include <algorithm>
+
+TextureResidency::TextureResidency() : materialSystem(nullptr), budget(0), frameIndex(0) {
+    stats = Stats();
+}
+
+void TextureResidency::startup(MaterialSystem* system, size_t budgetBytes) {
+    materialSystem = system;
+    budget = budgetBytes;
+    frameIndex = 0;
+    stats = Stats();
+}
+
+void TextureResidency::shutdown() {
+    entries.clear();
+    stats = Stats();
+}
+
+void TextureResidency::addTextures(const std::vector<int>& textureIds) {
+    for (int textureId : textureIds) {
+        if (textureId < 0) {
+            continue;
+        }
+        if (textureId >= (int)entries.size()) {
+            entries.resize(textureId + 1, Entry());
+        }
+
+        // New textures arrive at full resolution and count as just drawn
+        Entry& entry = entries[textureId];
+        entry.tracked = true;
+        entry.wantedLevel = 0;
+        entry.lastUsedFrame = frameIndex;
+    }
+}
+
+void TextureResidency::removeTextures(const std::vector<int>& textureIds) {
+    for (int textureId : textureIds) {
+        if (textureId >= 0 && textureId < (int)entries.size()) {
+            entries[textureId].tracked = false;
+        }
+    }
+}
+
+void TextureResidency::requestMaterial(GLuint materialId, float screenPixels) {
+    int diffuseTexture, normalTexture;
+    materialSystem->getMaterialTextures(materialId, diffuseTexture, normalTexture);
+    request(diffuseTexture, screenPixels);
+    request(normalTexture, screenPixels);
+}
+
+// Assumes the texture is stretched once across the surface, so a level whose size matches the
+// on-screen size is enough
+void TextureResidency::request(int textureId, float screenPixels) {
+    if (textureId < 0 || textureId >= (int)entries.size() || !entries[textureId].tracked) {
+        return;
+    }
+
+    int levelCount = materialSystem->getLevelCount(textureId);
+    int level = 0;
+    if (screenPixels > 0.0f) {
+        float ratio = materialSystem->getLargestDimension(textureId) / screenPixels;
+        level = ratio > 1.0f ? (int)floorf(log2f(ratio)) : 0;
+    }
+    level = std::min(level, levelCount - 1);
+
+    // The largest use this frame decides
+    Entry& entry = entries[textureId];
+    if (entry.lastUsedFrame != frameIndex) {
+        entry.wantedLevel = level;
+    }
+    else {
+        entry.wantedLevel = std::min(entry.wantedLevel, level);
+    }
+    entry.lastUsedFrame = frameIndex;
+}
+
+void TextureResidency::update() {
+    stats.budgetBytes = budget;
+    stats.residentBytes = 0;
+    stats.fullBytes = 0;
+    stats.textureCount = 0;
+    stats.reducedCount = 0;
+    stats.promotions = 0;
+    stats.evictions = 0;
+
+    std::vector<int> evictable;
+    std::vector<int> promotable;
+    for (size_t i = 0; i < entries.size(); i++) {
+        const Entry& entry = entries[i];
+        if (!entry.tracked) {
+            continue;
+        }
+
+        int textureId = (int)i;
+        int firstLevel = materialSystem->getFirstLevel(textureId);
+        stats.residentBytes += materialSystem->getTextureBytes(textureId, firstLevel);
+        stats.fullBytes += materialSystem->getTextureBytes(textureId, 0);
+        stats.textureCount++;
+        stats.reducedCount += firstLevel > 0 ? 1 : 0;
+
+        if (materialSystem->isLevelChangePending(textureId)) {
+            continue;
+        }
+        if (firstLevel < materialSystem->getLevelCount(textureId) - 1) {
+            evictable.push_back(textureId);
+        }
+        if (firstLevel > entry.wantedLevel && entry.lastUsedFrame + kRecentFrames >= frameIndex) {
+            promotable.push_back(textureId);
+        }
+    }
+
+    int changes = 0;
+    if (stats.residentBytes > budget) {
+        // Least recently drawn first, then the ones with the most detail beyond what they need
+        std::sort(evictable.begin(), evictable.end(), [this](int a, int b) {
+            if (entries[a].lastUsedFrame != entries[b].lastUsedFrame) {
+                return entries[a].lastUsedFrame < entries[b].lastUsedFrame;
+            }
+            return entries[a].wantedLevel - materialSystem->getFirstLevel(a) > entries[b].wantedLevel - materialSystem->getFirstLevel(b);
+        });
+
+        for (int textureId : evictable) {
+            if (stats.residentBytes <= budget || changes == kMaxChangesPerFrame) {
+                break;
+            }
+
+            int firstLevel = materialSystem->getFirstLevel(textureId);
+            size_t bytes = materialSystem->getTextureBytes(textureId, firstLevel);
+            if (materialSystem->requestFirstLevel(textureId, firstLevel + 1)) {
+                stats.residentBytes -= bytes - materialSystem->getTextureBytes(textureId, firstLevel + 1);
+                stats.reducedCount += firstLevel == 0 ? 1 : 0;
+                stats.evictions++;
+                changes++;
+            }
+        }
+    }
+    else {
+        // Most recently drawn first; a mip only comes back if it fits
+        std::sort(promotable.begin(), promotable.end(), [this](int a, int b) {
+            return entries[a].lastUsedFrame > entries[b].lastUsedFrame;
+        });
+
+        for (int textureId : promotable) {
+            if (changes == kMaxChangesPerFrame) {
+                break;
+            }
+
+            int firstLevel = materialSystem->getFirstLevel(textureId);
+            size_t extra = materialSystem->getTextureBytes(textureId, firstLevel - 1) - materialSystem->getTextureBytes(textureId, firstLevel);
+            if (stats.residentBytes + extra > budget) {
+                continue;
+            }
+
+            if (materialSystem->requestFirstLevel(textureId, firstLevel - 1)) {
+                stats.residentBytes += extra;
+                stats.reducedCount -= firstLevel == 1 ? 1 : 0;
+                stats.promotions++;
+                changes++;
+            }
+        }
+    }
+
+    frameIndex++;
+}
@@ -0,0 +1,110 @@
+#include "../headers/ThreadPool.h"
+#include <atomic>
+#include <memory>
+
+ThreadPool::ThreadPool() : stopping(false) {
+}
+
+ThreadPool::~ThreadPool() {
+    shutdown();
+}
+
+void ThreadPool::startup(unsigned int threadCount) {
+    if (threadCount == 0) {
+        unsigned int hardwareThreads = std::thread::hardware_concurrency();
+        threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+    }
+
+    stopping = false;
+    for (unsigned int i = 0; i < threadCount; i++) {
+        workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+    }
+}
+
+void ThreadPool::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    taskAvailable.notify_all();
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+    tasks.clear();
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    // Without workers the task runs inline, so callers never depend on the pool being started
+    if (workers.empty()) {
+        task();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+    taskAvailable.notify_one();
+}
+
+void ThreadPool::workerLoop() {
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            taskAvailable.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (stopping && tasks.empty()) {
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& body) {
+    if (count == 0) {
+        return;
+    }
+
+    // Indices are claimed one at a time, so uneven items (a 4K texture next to a tiny mesh) balance out
+    struct SharedState {
+        std::atomic<size_t> next;
+        size_t remaining;
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+    std::shared_ptr<SharedState> state = std::make_shared<SharedState>();
+    state->next = 0;
+    state->remaining = count;
+
+    const std::function<void(size_t)>* bodyPointer = &body;
+    auto drain = [state, bodyPointer, count]() {
+        size_t finished = 0;
+        for (size_t index = state->next++; index < count; index = state->next++) {
+            (*bodyPointer)(index);
+            finished++;
+        }
+
+        if (finished > 0) {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->remaining -= finished;
+            if (state->remaining == 0) {
+                state->done.notify_all();
+            }
+        }
+    };
+
+    size_t helpers = workers.size() < count - 1 ? workers.size() : count - 1;
+    for (size_t i = 0; i < helpers; i++) {
+        submit(drain);
+    }
+    drain();
+
+    // body stays alive until here; helpers that start late find no indices left and never call it
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->done.wait(lock, [&state] { return state->remaining == 0; });
+}
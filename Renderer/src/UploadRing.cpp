@@ -0,0 +1,495 @@
+#include "../headers/UploadRing.h"
+#include <string.h>
+#include <algorithm>
+
+// Bytes the upload thread copies between completion fences
+static const size_t kThreadBatchBytes = 4 * 1024 * 1024;
+// How long the upload thread blocks on the oldest region when the ring is full
+static const GLuint64 kRingFullWaitNanoseconds = 1000000;
+
+UploadRing::UploadRing()
+    : stagingBuffer(0), mappedData(nullptr), capacity(0), head(0), used(0), batchBytes(0),
+      queuedTicket(0), submittedTicket(0), uploadContext(nullptr), releasedTicket(0), workerTicket(0),
+      stopping(false), paused(false), workerBusy(false) {
+}
+
+void UploadRing::startup(size_t ringCapacity, GLFWwindow* shareWindow) {
+    capacity = ringCapacity;
+
+    if (!gl3wIsSupported(4, 4) && !glfwExtensionSupported("GL_ARB_buffer_storage")) {
+        OutputDebugStringA("\nGL_ARB_buffer_storage unavailable, uploads are synchronous");
+        return;
+    }
+
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    glGenBuffers(1, &stagingBuffer);
+    glBindBuffer(GL_COPY_READ_BUFFER, stagingBuffer);
+    glBufferStorage(GL_COPY_READ_BUFFER, capacity, NULL, flags);
+    mappedData = static_cast<unsigned char*>(glMapBufferRange(GL_COPY_READ_BUFFER, 0, capacity, flags));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+    if (!mappedData) {
+        OutputDebugStringA("\nFailed to map upload ring, uploads are synchronous");
+        glDeleteBuffers(1, &stagingBuffer);
+        stagingBuffer = 0;
+        return;
+    }
+
+    if (!shareWindow) {
+        return;
+    }
+
+    // The upload context must be created on the main thread; the upload thread only makes it current
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    uploadContext = glfwCreateWindow(1, 1, "Uploads", NULL, shareWindow);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+    if (!uploadContext) {
+        OutputDebugStringA("\nFailed to create shared upload context, uploads stay on the render thread");
+        return;
+    }
+
+    stopping = false;
+    paused = false;
+    workerBusy = false;
+    releasedTicket = workerTicket = submittedTicket;
+    uploadThread = std::thread(&UploadRing::uploadThreadLoop, this);
+}
+
+void UploadRing::shutdown() {
+    if (uploadThread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        workAvailable.notify_all();
+        uploadThread.join();
+    }
+
+    if (uploadContext) {
+        glfwDestroyWindow(uploadContext);
+        uploadContext = nullptr;
+    }
+
+    for (HandOff& handOff : releases) {
+        glDeleteSync(handOff.fence);
+    }
+    for (HandOff& handOff : completed) {
+        glDeleteSync(handOff.fence);
+    }
+    releases.clear();
+    completed.clear();
+
+    for (InFlightRegion& region : inFlight) {
+        glDeleteSync(region.fence);
+    }
+    inFlight.clear();
+    pending.clear();
+
+    if (stagingBuffer) {
+        glBindBuffer(GL_COPY_READ_BUFFER, stagingBuffer);
+        glUnmapBuffer(GL_COPY_READ_BUFFER);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glDeleteBuffers(1, &stagingBuffer);
+    }
+
+    stagingBuffer = 0;
+    mappedData = nullptr;
+    head = used = batchBytes = 0;
+}
+
+UploadRing::Ticket UploadRing::queueBuffer(GLuint buffer, GLintptr offset, const void* data, size_t size) {
+    if (!isPersistent()) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        submittedTicket = ++queuedTicket;
+        return submittedTicket;
+    }
+
+    PendingUpload upload;
+    upload.type = Upload_Buffer;
+    upload.target = buffer;
+    upload.offset = offset;
+    upload.textureTarget = GL_NONE;
+    upload.level = 0;
+    upload.layer = 0;
+    upload.width = upload.height = 0;
+    upload.format = GL_NONE;
+    upload.compressed = false;
+    upload.rowBytes = 1;
+    upload.consumed = 0;
+    upload.data.assign(static_cast<const unsigned char*>(data), static_cast<const unsigned char*>(data) + size);
+    return enqueue(upload);
+}
+
+UploadRing::Ticket UploadRing::enqueue(PendingUpload& upload) {
+    std::lock_guard<std::mutex> lock(mutex);
+    upload.ticket = ++queuedTicket;
+    pending.push_back(std::move(upload));
+    return queuedTicket;
+}
+
+static bool isCompressedFormat(GLenum format) {
+    return format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || format == GL_COMPRESSED_RG_RGTC2 || format == GL_COMPRESSED_RGBA_BPTC_UNORM;
+}
+
+// Uploads a band of rows into a 2D texture or into one layer of a 2D array texture.
+// firstRow and rows are in texels; block data needs its byte size as well.
+static void uploadTextureRows(GLenum target, GLint level, GLint layer, GLint firstRow, GLsizei width, GLsizei rows, GLenum format, bool compressed, GLsizei imageSize, const void* data) {
+    if (compressed) {
+        if (target == GL_TEXTURE_2D_ARRAY) {
+            glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, firstRow, layer, width, rows, 1, format, imageSize, data);
+        }
+        else {
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, firstRow, width, rows, format, imageSize, data);
+        }
+    }
+    else if (target == GL_TEXTURE_2D_ARRAY) {
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, firstRow, layer, width, rows, 1, format, GL_UNSIGNED_BYTE, data);
+    }
+    else {
+        glTexSubImage2D(GL_TEXTURE_2D, level, 0, firstRow, width, rows, format, GL_UNSIGNED_BYTE, data);
+    }
+}
+
+UploadRing::Ticket UploadRing::queueTexture(GLuint texture, GLenum target, GLint level, GLint layer, GLsizei width, GLsizei height, GLenum format, const void* data, size_t size) {
+    bool compressed = isCompressedFormat(format);
+    GLsizei rowCount = compressed ? (height + 3) / 4 : height;
+    size_t rowBytes = rowCount > 0 ? size / rowCount : size;
+
+    // A single row must fit in the ring; otherwise go straight to the driver
+    if (!isPersistent() || rowBytes > capacity) {
+        glBindTexture(target, texture);
+        uploadTextureRows(target, level, layer, 0, width, height, format, compressed, (GLsizei)size, data);
+        submittedTicket = ++queuedTicket;
+        return submittedTicket;
+    }
+
+    PendingUpload upload;
+    upload.type = Upload_Texture;
+    upload.target = texture;
+    upload.offset = 0;
+    upload.textureTarget = target;
+    upload.level = level;
+    upload.layer = layer;
+    upload.width = width;
+    upload.height = height;
+    upload.format = format;
+    upload.compressed = compressed;
+    upload.rowBytes = rowBytes;
+    upload.consumed = 0;
+    upload.data.assign(static_cast<const unsigned char*>(data), static_cast<const unsigned char*>(data) + size);
+    return enqueue(upload);
+}
+
+// The upload thread pops its last upload before it publishes that batch's hand-off, so pending
+// and completed are both empty for a moment while the batch is still unaccounted for
+bool UploadRing::isIdle() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return pending.empty() && releases.empty() && completed.empty() && !workerBusy;
+}
+
+void UploadRing::pause() {
+    if (!isThreaded()) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    paused = true;
+    workerIdle.wait(lock, [this] { return !workerBusy; });
+
+    // Commands on this context now run after every copy the upload thread has issued
+    if (!completed.empty()) {
+        glWaitSync(completed.back().fence, 0, GL_TIMEOUT_IGNORED);
+    }
+}
+
+void UploadRing::resume() {
+    if (!isThreaded()) {
+        return;
+    }
+
+    // The fence published here also orders the upload thread after the reallocation
+    releaseQueued();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        paused = false;
+    }
+    workAvailable.notify_one();
+}
+
+void UploadRing::retargetBuffer(GLuint oldBuffer, GLuint newBuffer) {
+    for (PendingUpload& upload : pending) {
+        if (upload.type == Upload_Buffer && upload.target == oldBuffer) {
+            upload.target = newBuffer;
+        }
+    }
+}
+
+size_t UploadRing::flush(size_t byteBudget) {
+    if (isThreaded()) {
+        releaseQueued();
+        return collectCompleted();
+    }
+
+    if (!isPersistent() || pending.empty()) {
+        return 0;
+    }
+
+    retireRegions();
+
+    size_t submitted = 0;
+    while (!pending.empty() && submitted < byteBudget) {
+        PendingUpload& upload = pending.front();
+
+        if (upload.consumed < upload.data.size()) {
+            size_t bytes = submitChunk(upload, byteBudget - submitted);
+            if (bytes == 0) {
+                break; // Ring is full until the GPU catches up
+            }
+            submitted += bytes;
+        }
+
+        if (upload.consumed == upload.data.size()) {
+            submittedTicket = upload.ticket;
+            pending.pop_front();
+        }
+    }
+
+    if (batchBytes > 0) {
+        InFlightRegion region;
+        region.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        region.size = batchBytes;
+        inFlight.push_back(region);
+        batchBytes = 0;
+    }
+
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    return submitted;
+}
+
+void UploadRing::retireRegions() {
+    while (!inFlight.empty()) {
+        GLenum status = glClientWaitSync(inFlight.front().fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+            break;
+        }
+
+        glDeleteSync(inFlight.front().fence);
+        used -= inFlight.front().size;
+        inFlight.pop_front();
+    }
+
+    if (used == 0) {
+        head = 0;
+    }
+}
+
+bool UploadRing::allocate(size_t size, size_t& offset) {
+    size_t aligned = (size + 15) & ~(size_t)15;
+
+    // Skip the tail end of the ring when the allocation doesn't fit before wrapping
+    if (head + aligned > capacity) {
+        size_t waste = capacity - head;
+        if (used + waste + aligned > capacity) {
+            return false;
+        }
+        used += waste;
+        batchBytes += waste;
+        head = 0;
+    }
+
+    if (used + aligned > capacity) {
+        return false;
+    }
+
+    offset = head;
+    head += aligned;
+    used += aligned;
+    batchBytes += aligned;
+    return true;
+}
+
+size_t UploadRing::submitChunk(PendingUpload& upload, size_t byteBudget) {
+    size_t remaining = upload.data.size() - upload.consumed;
+    size_t chunk = std::min(remaining, std::min(capacity / 4, byteBudget));
+
+    // Textures are split on whole rows
+    size_t rows = 0;
+    if (upload.type == Upload_Texture) {
+        rows = std::max<size_t>(chunk / upload.rowBytes, 1);
+        chunk = rows * upload.rowBytes;
+    }
+
+    size_t offset;
+    if (!allocate(chunk, offset)) {
+        return 0;
+    }
+
+    memcpy(mappedData + offset, upload.data.data() + upload.consumed, chunk);
+
+    if (upload.type == Upload_Buffer) {
+        glBindBuffer(GL_COPY_READ_BUFFER, stagingBuffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, upload.target);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset, upload.offset + upload.consumed, chunk);
+    }
+    else {
+        // Block rows cover four texel rows, the last one possibly fewer
+        GLint rowHeight = upload.compressed ? 4 : 1;
+        GLint firstRow = (GLint)(upload.consumed / upload.rowBytes) * rowHeight;
+        GLsizei texelRows = std::min((GLsizei)rows * rowHeight, upload.height - firstRow);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBuffer);
+        glBindTexture(upload.textureTarget, upload.target);
+        uploadTextureRows(upload.textureTarget, upload.level, upload.layer, firstRow, upload.width, texelRows, upload.format,
+            upload.compressed, (GLsizei)chunk, (void*)offset);
+    }
+
+    upload.consumed += chunk;
+    return chunk;
+}
+
+// Hands everything queued so far to the upload thread behind a fence, so the textures and
+// buffers it writes to exist on the GPU by the time its copies execute
+void UploadRing::releaseQueued() {
+    std::unique_lock<std::mutex> lock(mutex);
+    Ticket ticket = queuedTicket;
+    Ticket lastReleased = releases.empty() ? releasedTicket : releases.back().ticket;
+    if (ticket == lastReleased && !paused) {
+        return;
+    }
+    lock.unlock();
+
+    HandOff release;
+    release.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    release.ticket = ticket;
+    release.bytes = 0;
+    glFlush(); // The other context can only wait on a fence that has been flushed
+
+    lock.lock();
+    releases.push_back(release);
+    lock.unlock();
+    workAvailable.notify_one();
+}
+
+// Advances submittedTicket past every batch whose copies have finished on the GPU
+size_t UploadRing::collectCompleted() {
+    size_t bytes = 0;
+    std::lock_guard<std::mutex> lock(mutex);
+    while (!completed.empty()) {
+        GLenum status = glClientWaitSync(completed.front().fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+            break;
+        }
+
+        glDeleteSync(completed.front().fence);
+        submittedTicket = completed.front().ticket;
+        bytes += completed.front().bytes;
+        completed.pop_front();
+    }
+    return bytes;
+}
+
+bool UploadRing::hasReleasedWork() const {
+    return !pending.empty() && pending.front().ticket <= releasedTicket;
+}
+
+void UploadRing::uploadThreadLoop() {
+    glfwMakeContextCurrent(uploadContext);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // Staged rows are tightly packed
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            workAvailable.wait(lock, [this] { return stopping || (!paused && (!releases.empty() || hasReleasedWork())); });
+            if (stopping) {
+                break;
+            }
+
+            // Server-side waits; the deletes are deferred by GL until the waits are done
+            for (HandOff& release : releases) {
+                glWaitSync(release.fence, 0, GL_TIMEOUT_IGNORED);
+                glDeleteSync(release.fence);
+                releasedTicket = release.ticket;
+            }
+            releases.clear();
+            workerBusy = true;
+        }
+
+        submitBatch();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            workerBusy = false;
+        }
+        workerIdle.notify_all();
+    }
+
+    glfwMakeContextCurrent(NULL);
+}
+
+// Copies up to kThreadBatchBytes of released uploads and publishes a completion fence for them.
+// The front upload is used by reference without the lock: the render thread only appends to
+// pending, which leaves existing elements in place, and only retargets them while paused.
+void UploadRing::submitBatch() {
+    retireRegions();
+
+    size_t submitted = 0;
+    while (submitted < kThreadBatchBytes) {
+        PendingUpload* upload;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping || paused || !hasReleasedWork()) {
+                break;
+            }
+            upload = &pending.front();
+        }
+
+        size_t bytes = submitChunk(*upload, kThreadBatchBytes - submitted);
+        if (bytes == 0) {
+            if (batchBytes > 0) {
+                break; // Fence what this batch used so its space can come back
+            }
+
+            // Ring is full of earlier batches; this thread can afford to block on the oldest one
+            if (!inFlight.empty()) {
+                glClientWaitSync(inFlight.front().fence, GL_SYNC_FLUSH_COMMANDS_BIT, kRingFullWaitNanoseconds);
+            }
+            retireRegions();
+            continue;
+        }
+        submitted += bytes;
+
+        if (upload->consumed == upload->data.size()) {
+            std::lock_guard<std::mutex> lock(mutex);
+            workerTicket = upload->ticket;
+            pending.pop_front();
+        }
+    }
+
+    if (batchBytes > 0) {
+        InFlightRegion region;
+        region.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        region.size = batchBytes;
+        inFlight.push_back(region);
+        batchBytes = 0;
+    }
+
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (submitted > 0) {
+        HandOff handOff;
+        handOff.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        handOff.ticket = workerTicket;
+        handOff.bytes = submitted;
+        glFlush();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        completed.push_back(handOff);
+    }
+}
@@ -0,0 +1,283 @@
+#include "../headers/VertexQuantization.h"
+#include "../headers/MeshImport.h"
+#include <math.h>
+#include <string.h>
+
+namespace VertexQuantization {
+    static const float kRadiansToDegrees = 57.2957795f;
+
+    unsigned short floatToHalf(float value) {
+        unsigned int bits;
+        memcpy(&bits, &value, sizeof(bits));
+
+        unsigned int sign = (bits >> 16) & 0x8000;
+        int exponent = (int)((bits >> 23) & 0xFF) - 127 + 15;
+        unsigned int mantissa = bits & 0x7FFFFF;
+
+        // NaN and infinity
+        if (((bits >> 23) & 0xFF) == 0xFF) {
+            return (unsigned short)(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+        }
+        if (exponent >= 31) {
+            return (unsigned short)(sign | 0x7C00);
+        }
+
+        // Too small for a normal half: denormal or zero, rounded to nearest
+        if (exponent <= 0) {
+            if (exponent < -10) {
+                return (unsigned short)sign;
+            }
+            mantissa |= 0x800000;
+            unsigned int shift = (unsigned int)(14 - exponent);
+            unsigned int half = mantissa >> shift;
+            unsigned int remainder = mantissa & ((1u << shift) - 1);
+            unsigned int halfway = 1u << (shift - 1);
+            if (remainder > halfway || (remainder == halfway && (half & 1))) {
+                half++;
+            }
+            return (unsigned short)(sign | half);
+        }
+
+        // Round to nearest even; a carry into the exponent is still the right result
+        unsigned int half = ((unsigned int)exponent << 10) | (mantissa >> 13);
+        unsigned int remainder = mantissa & 0x1FFF;
+        if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+            half++;
+        }
+        return (unsigned short)(sign | half);
+    }
+
+    float halfToFloat(unsigned short value) {
+        unsigned int sign = (unsigned int)(value & 0x8000) << 16;
+        unsigned int exponent = (value >> 10) & 0x1F;
+        unsigned int mantissa = value & 0x3FF;
+
+        unsigned int bits;
+        if (exponent == 0) {
+            // Zero or denormal: mantissa * 2^-24
+            float magnitude = (float)mantissa * (1.0f / 16777216.0f);
+            return sign ? -magnitude : magnitude;
+        }
+        else if (exponent == 31) {
+            bits = sign | 0x7F800000 | (mantissa << 13);
+        }
+        else {
+            bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+        }
+
+        float result;
+        memcpy(&result, &bits, sizeof(result));
+        return result;
+    }
+
+    // GL's rule for normalized signed 10-bit components
+    static float decodeSnorm10(int value) {
+        float decoded = (float)value / 511.0f;
+        return decoded < -1.0f ? -1.0f : decoded;
+    }
+
+    static void octahedralDecode(float u, float v, float n[3]) {
+        n[0] = u;
+        n[1] = v;
+        n[2] = 1.0f - fabsf(u) - fabsf(v);
+        if (n[2] < 0.0f) {
+            float x = n[0];
+            n[0] = (1.0f - fabsf(n[1])) * (x >= 0.0f ? 1.0f : -1.0f);
+            n[1] = (1.0f - fabsf(x)) * (n[1] >= 0.0f ? 1.0f : -1.0f);
+        }
+
+        float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        n[0] /= length;
+        n[1] /= length;
+        n[2] /= length;
+    }
+
+    // Packs a unit vector into x/y of a 2_10_10_10 word. Of the four grid points around the exact
+    // encoding, the one that decodes closest wins. Returns the angle error in degrees.
+    static float packOctahedral(const float n[3], int w, unsigned int& packed) {
+        float sum = fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]);
+        float u = n[0] / sum;
+        float v = n[1] / sum;
+        if (n[2] < 0.0f) {
+            float x = u;
+            u = (1.0f - fabsf(v)) * (x >= 0.0f ? 1.0f : -1.0f);
+            v = (1.0f - fabsf(x)) * (v >= 0.0f ? 1.0f : -1.0f);
+        }
+
+        int baseU = (int)floorf(u * 511.0f);
+        int baseV = (int)floorf(v * 511.0f);
+        int bestU = 0;
+        int bestV = 0;
+        float bestDot = -2.0f;
+        for (int i = 0; i < 4; i++) {
+            int qu = baseU + (i & 1);
+            int qv = baseV + (i >> 1);
+            qu = qu < -511 ? -511 : (qu > 511 ? 511 : qu);
+            qv = qv < -511 ? -511 : (qv > 511 ? 511 : qv);
+
+            float decoded[3];
+            octahedralDecode(decodeSnorm10(qu), decodeSnorm10(qv), decoded);
+            float dot = decoded[0] * n[0] + decoded[1] * n[1] + decoded[2] * n[2];
+            if (dot > bestDot) {
+                bestDot = dot;
+                bestU = qu;
+                bestV = qv;
+            }
+        }
+
+        packed = ((unsigned int)bestU & 0x3FF) | (((unsigned int)bestV & 0x3FF) << 10) | (((unsigned int)w & 0x3) << 30);
+        return acosf(bestDot > 1.0f ? 1.0f : bestDot) * kRadiansToDegrees;
+    }
+
+    // Unit length copy; a missing attribute (all zeros) becomes +Z
+    static bool normalizeOrDefault(const float* in, float out[3]) {
+        float length = sqrtf(in[0] * in[0] + in[1] * in[1] + in[2] * in[2]);
+        if (length <= 0.0f) {
+            out[0] = 0.0f;
+            out[1] = 0.0f;
+            out[2] = 1.0f;
+            return false;
+        }
+
+        out[0] = in[0] / length;
+        out[1] = in[1] / length;
+        out[2] = in[2] / length;
+        return true;
+    }
+
+    // Per vertex: +1 if its triangles' UVs wind the same way as most of the mesh, -1 where they
+    // are mirrored. The float layout has no sign (the shaders use cross(N, T)), so meshes without
+    // mirrored UVs shade the same in both layouts.
+    static void computeBitangentSigns(const std::vector<float>& vertices, const std::vector<unsigned int>& indices, std::vector<int>& signs) {
+        const int stride = MeshImport::kFloatsPerVertex;
+        const size_t vertexCount = vertices.size() / stride;
+
+        std::vector<float> bitangents(vertexCount * 3, 0.0f);
+        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+            const float* p0 = &vertices[(size_t)indices[i] * stride];
+            const float* p1 = &vertices[(size_t)indices[i + 1] * stride];
+            const float* p2 = &vertices[(size_t)indices[i + 2] * stride];
+
+            float du1 = p1[9] - p0[9];
+            float dv1 = p1[10] - p0[10];
+            float du2 = p2[9] - p0[9];
+            float dv2 = p2[10] - p0[10];
+            float determinant = du1 * dv2 - du2 * dv1;
+            if (determinant == 0.0f) {
+                continue;
+            }
+
+            // Area-weighted bitangent direction; dividing by the determinant would only scale it
+            float orientation = determinant > 0.0f ? 1.0f : -1.0f;
+            for (int axis = 0; axis < 3; axis++) {
+                float e1 = p1[axis] - p0[axis];
+                float e2 = p2[axis] - p0[axis];
+                float bitangent = (e2 * du1 - e1 * du2) * orientation;
+                for (int corner = 0; corner < 3; corner++) {
+                    bitangents[(size_t)indices[i + corner] * 3 + axis] += bitangent;
+                }
+            }
+        }
+
+        signs.assign(vertexCount, 1);
+        int balance = 0;
+        for (size_t i = 0; i < vertexCount; i++) {
+            const float* n = &vertices[i * stride + 3];
+            const float* t = &vertices[i * stride + 6];
+            const float* b = &bitangents[i * 3];
+            float crossX = n[1] * t[2] - n[2] * t[1];
+            float crossY = n[2] * t[0] - n[0] * t[2];
+            float crossZ = n[0] * t[1] - n[1] * t[0];
+            float handedness = crossX * b[0] + crossY * b[1] + crossZ * b[2];
+            signs[i] = handedness < 0.0f ? -1 : 1;
+            balance += handedness < 0.0f ? -1 : (handedness > 0.0f ? 1 : 0);
+        }
+
+        if (balance < 0) {
+            for (int& sign : signs) {
+                sign = -sign;
+            }
+        }
+    }
+
+    Error quantize(const std::vector<float>& vertices, const std::vector<unsigned int>& indices,
+        std::vector<unsigned char>& packed, vmath::vec4& positionDequant) {
+        const int stride = MeshImport::kFloatsPerVertex;
+        const size_t vertexCount = vertices.size() / stride;
+
+        Error error = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+        packed.resize(vertexCount * kCompactStride);
+        positionDequant = vmath::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        if (vertexCount == 0) {
+            return error;
+        }
+
+        float boundsMin[3] = { vertices[0], vertices[1], vertices[2] };
+        float boundsMax[3] = { vertices[0], vertices[1], vertices[2] };
+        for (size_t i = 1; i < vertexCount; i++) {
+            for (int axis = 0; axis < 3; axis++) {
+                float value = vertices[i * stride + axis];
+                boundsMin[axis] = value < boundsMin[axis] ? value : boundsMin[axis];
+                boundsMax[axis] = value > boundsMax[axis] ? value : boundsMax[axis];
+            }
+        }
+
+        float extent = 0.0f;
+        for (int axis = 0; axis < 3; axis++) {
+            extent = boundsMax[axis] - boundsMin[axis] > extent ? boundsMax[axis] - boundsMin[axis] : extent;
+        }
+        float scale = extent > 0.0f ? extent : 1.0f;
+        positionDequant = vmath::vec4(boundsMin[0], boundsMin[1], boundsMin[2], scale);
+
+        std::vector<int> signs;
+        computeBitangentSigns(vertices, indices, signs);
+
+        for (size_t i = 0; i < vertexCount; i++) {
+            const float* v = &vertices[i * stride];
+            unsigned char* out = &packed[i * kCompactStride];
+
+            unsigned short position[4] = { 0, 0, 0, 0 };
+            float positionErrorSquared = 0.0f;
+            for (int axis = 0; axis < 3; axis++) {
+                float normalized = (v[axis] - boundsMin[axis]) / scale;
+                float rounded = floorf(normalized * 65535.0f + 0.5f);
+                rounded = rounded < 0.0f ? 0.0f : (rounded > 65535.0f ? 65535.0f : rounded);
+                position[axis] = (unsigned short)rounded;
+
+                float difference = rounded / 65535.0f * scale + boundsMin[axis] - v[axis];
+                positionErrorSquared += difference * difference;
+            }
+            float positionError = sqrtf(positionErrorSquared);
+            error.position = positionError > error.position ? positionError : error.position;
+            memcpy(out + kPositionOffset, position, sizeof(position));
+
+            float normal[3];
+            unsigned int packedNormal;
+            bool hasNormal = normalizeOrDefault(v + 3, normal);
+            float normalError = packOctahedral(normal, 0, packedNormal);
+            if (hasNormal && normalError > error.normalDegrees) {
+                error.normalDegrees = normalError;
+            }
+            memcpy(out + kNormalOffset, &packedNormal, sizeof(packedNormal));
+
+            float tangent[3];
+            unsigned int packedTangent;
+            bool hasTangent = normalizeOrDefault(v + 6, tangent);
+            float tangentError = packOctahedral(tangent, signs[i], packedTangent);
+            if (hasTangent && tangentError > error.tangentDegrees) {
+                error.tangentDegrees = tangentError;
+            }
+            memcpy(out + kTangentOffset, &packedTangent, sizeof(packedTangent));
+
+            unsigned short texCoords[2] = { floatToHalf(v[9]), floatToHalf(v[10]) };
+            for (int component = 0; component < 2; component++) {
+                float difference = fabsf(halfToFloat(texCoords[component]) - v[9 + component]);
+                error.texCoord = difference > error.texCoord ? difference : error.texCoord;
+            }
+            memcpy(out + kTexCoordOffset, texCoords, sizeof(texCoords));
+        }
+
+        error.positionRelative = extent > 0.0f ? error.position / extent : 0.0f;
+        return error;
+    }
+}
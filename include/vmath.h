@@ -5,6 +5,13 @@
 #define _USE_MATH_DEFINES  1 // Include constants defined in math.h
 #include <math.h>
 
+// Opt-in SSE2 versions of the float vec4 / mat4 hot paths: define VMATH_SIMD before including.
+// Results match the scalar code within float rounding (the products are summed in the same order).
+#if defined(VMATH_SIMD) && (defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__))
+#define VMATH_SSE 1
+#include <emmintrin.h>
+#endif
+
 namespace vmath
 {
 
@@ -254,6 +261,40 @@ protected:
     }
 };
 
+#ifdef VMATH_SSE
+template <>
+inline vecN<float,4> vecN<float,4>::operator+(const vecN<float,4>& that) const
+{
+    vecN<float,4> result;
+    _mm_storeu_ps(result.data, _mm_add_ps(_mm_loadu_ps(data), _mm_loadu_ps(that.data)));
+    return result;
+}
+
+template <>
+inline vecN<float,4> vecN<float,4>::operator-(const vecN<float,4>& that) const
+{
+    vecN<float,4> result;
+    _mm_storeu_ps(result.data, _mm_sub_ps(_mm_loadu_ps(data), _mm_loadu_ps(that.data)));
+    return result;
+}
+
+template <>
+inline vecN<float,4> vecN<float,4>::operator*(const vecN<float,4>& that) const
+{
+    vecN<float,4> result;
+    _mm_storeu_ps(result.data, _mm_mul_ps(_mm_loadu_ps(data), _mm_loadu_ps(that.data)));
+    return result;
+}
+
+template <>
+inline vecN<float,4> vecN<float,4>::operator*(const float& that) const
+{
+    vecN<float,4> result;
+    _mm_storeu_ps(result.data, _mm_mul_ps(_mm_loadu_ps(data), _mm_set1_ps(that)));
+    return result;
+}
+#endif
+
 template <typename T>
 class Tvec2 : public vecN<T,2>
 {
@@ -886,6 +927,49 @@ protected:
     }
 };
 
+
+#ifdef VMATH_SSE
+template <>
+inline matNM<float,4,4> matNM<float,4,4>::operator*(const matNM<float,4,4>& that) const
+{
+    __m128 c0 = _mm_loadu_ps(&data[0][0]);
+    __m128 c1 = _mm_loadu_ps(&data[1][0]);
+    __m128 c2 = _mm_loadu_ps(&data[2][0]);
+    __m128 c3 = _mm_loadu_ps(&data[3][0]);
+
+    // Column j of the result is this matrix's columns weighted by column j of that
+    matNM<float,4,4> result;
+    for (int j = 0; j < 4; j++)
+    {
+        const float* b = &that[j][0];
+        __m128 sum = _mm_mul_ps(c0, _mm_set1_ps(b[0]));
+        sum = _mm_add_ps(sum, _mm_mul_ps(c1, _mm_set1_ps(b[1])));
+        sum = _mm_add_ps(sum, _mm_mul_ps(c2, _mm_set1_ps(b[2])));
+        sum = _mm_add_ps(sum, _mm_mul_ps(c3, _mm_set1_ps(b[3])));
+        _mm_storeu_ps(&result[j][0], sum);
+    }
+
+    return result;
+}
+
+template <>
+inline matNM<float,4,4> matNM<float,4,4>::transpose(void) const
+{
+    __m128 c0 = _mm_loadu_ps(&data[0][0]);
+    __m128 c1 = _mm_loadu_ps(&data[1][0]);
+    __m128 c2 = _mm_loadu_ps(&data[2][0]);
+    __m128 c3 = _mm_loadu_ps(&data[3][0]);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+    matNM<float,4,4> result;
+    _mm_storeu_ps(&result[0][0], c0);
+    _mm_storeu_ps(&result[1][0], c1);
+    _mm_storeu_ps(&result[2][0], c2);
+    _mm_storeu_ps(&result[3][0], c3);
+    return result;
+}
+#endif
+
 /*
 template <typename T, const int N>
 class TmatN : public matNM<T,N,N>
@@ -1248,6 +1332,148 @@ static inline vecN<T,N> operator*(const vecN<T,M>& vec, const matNM<T,N,M>& mat)
     return result;
 }
 
+// Column vector transform (mat * vec), as opposed to vec * mat above
+template <typename T>
+static inline vecN<T,4> operator*(const matNM<T,4,4>& mat, const vecN<T,4>& vec)
+{
+    vecN<T,4> result(T(0));
+
+    for (int m = 0; m < 4; m++)
+    {
+        for (int n = 0; n < 4; n++)
+        {
+            result[n] += mat[m][n] * vec[m];
+        }
+    }
+
+    return result;
+}
+
+// General inverse by cofactor expansion. A singular matrix gives non-finite values.
+template <typename T>
+static inline Tmat4<T> inverse(const matNM<T,4,4>& mat)
+{
+    const T* m = mat;
+    T inv[16];
+
+    inv[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+    inv[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+    inv[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+    inv[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+    inv[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+    inv[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+    inv[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+    inv[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+    inv[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+    inv[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+    inv[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+    inv[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+    inv[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+    inv[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+    inv[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+    inv[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+    T det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+    T invDet = T(1) / det;
+
+    Tmat4<T> result;
+    for (int i = 0; i < 16; i++)
+    {
+        result[i / 4][i % 4] = inv[i] * invDet;
+    }
+
+    return result;
+}
+
+#ifdef VMATH_SSE
+// Non-template overloads, preferred over the generic versions above for float
+static inline vecN<float,4> operator*(const matNM<float,4,4>& mat, const vecN<float,4>& vec)
+{
+    __m128 sum = _mm_mul_ps(_mm_loadu_ps(&mat[0][0]), _mm_set1_ps(vec[0]));
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(&mat[1][0]), _mm_set1_ps(vec[1])));
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(&mat[2][0]), _mm_set1_ps(vec[2])));
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(&mat[3][0]), _mm_set1_ps(vec[3])));
+
+    vecN<float,4> result;
+    _mm_storeu_ps(&result[0], sum);
+    return result;
+}
+
+#define VMATH_SHUFFLE(a, b, x, y, z, w) _mm_shuffle_ps(a, b, _MM_SHUFFLE(w, z, y, x))
+#define VMATH_SWIZZLE(a, x, y, z, w) _mm_castsi128_ps(_mm_shuffle_epi32(_mm_castps_si128(a), _MM_SHUFFLE(w, z, y, x)))
+
+// 2x2 helpers for the block inverse; a 2x2 matrix is packed as (m00, m01, m10, m11)
+static inline __m128 mat2Mul(__m128 a, __m128 b)
+{
+    return _mm_add_ps(_mm_mul_ps(a, VMATH_SWIZZLE(b, 0, 3, 0, 3)), _mm_mul_ps(VMATH_SWIZZLE(a, 1, 0, 3, 2), VMATH_SWIZZLE(b, 2, 1, 2, 1)));
+}
+
+// adj(a) * b
+static inline __m128 mat2AdjMul(__m128 a, __m128 b)
+{
+    return _mm_sub_ps(_mm_mul_ps(VMATH_SWIZZLE(a, 3, 3, 0, 0), b), _mm_mul_ps(VMATH_SWIZZLE(a, 1, 1, 2, 2), VMATH_SWIZZLE(b, 2, 3, 0, 1)));
+}
+
+// a * adj(b)
+static inline __m128 mat2MulAdj(__m128 a, __m128 b)
+{
+    return _mm_sub_ps(_mm_mul_ps(a, VMATH_SWIZZLE(b, 3, 0, 3, 0)), _mm_mul_ps(VMATH_SWIZZLE(a, 1, 0, 3, 2), VMATH_SWIZZLE(b, 2, 1, 2, 1)));
+}
+
+// Block-wise 2x2 inverse. Works on columns as if they were rows, which is fine since
+// inverse(transpose(M)) == transpose(inverse(M)).
+static inline Tmat4<float> inverse(const matNM<float,4,4>& mat)
+{
+    __m128 r0 = _mm_loadu_ps(&mat[0][0]);
+    __m128 r1 = _mm_loadu_ps(&mat[1][0]);
+    __m128 r2 = _mm_loadu_ps(&mat[2][0]);
+    __m128 r3 = _mm_loadu_ps(&mat[3][0]);
+
+    __m128 a = _mm_movelh_ps(r0, r1);
+    __m128 b = _mm_movehl_ps(r1, r0);
+    __m128 c = _mm_movelh_ps(r2, r3);
+    __m128 d = _mm_movehl_ps(r3, r2);
+
+    // (|A|, |B|, |C|, |D|)
+    __m128 detSub = _mm_sub_ps(
+        _mm_mul_ps(VMATH_SHUFFLE(r0, r2, 0, 2, 0, 2), VMATH_SHUFFLE(r1, r3, 1, 3, 1, 3)),
+        _mm_mul_ps(VMATH_SHUFFLE(r0, r2, 1, 3, 1, 3), VMATH_SHUFFLE(r1, r3, 0, 2, 0, 2)));
+    __m128 detA = VMATH_SWIZZLE(detSub, 0, 0, 0, 0);
+    __m128 detB = VMATH_SWIZZLE(detSub, 1, 1, 1, 1);
+    __m128 detC = VMATH_SWIZZLE(detSub, 2, 2, 2, 2);
+    __m128 detD = VMATH_SWIZZLE(detSub, 3, 3, 3, 3);
+
+    __m128 dc = mat2AdjMul(d, c);
+    __m128 ab = mat2AdjMul(a, b);
+    __m128 x = _mm_sub_ps(_mm_mul_ps(detD, a), mat2Mul(b, dc));
+    __m128 w = _mm_sub_ps(_mm_mul_ps(detA, d), mat2Mul(c, ab));
+    __m128 y = _mm_sub_ps(_mm_mul_ps(detB, c), mat2MulAdj(d, ab));
+    __m128 z = _mm_sub_ps(_mm_mul_ps(detC, b), mat2MulAdj(a, dc));
+
+    // |M| = |A||D| + |B||C| - tr(adj(A)B adj(D)C)
+    __m128 trace = _mm_mul_ps(ab, VMATH_SWIZZLE(dc, 0, 2, 1, 3));
+    trace = _mm_add_ps(trace, VMATH_SWIZZLE(trace, 2, 3, 0, 1));
+    trace = _mm_add_ps(trace, VMATH_SWIZZLE(trace, 1, 0, 3, 2));
+    __m128 det = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(detA, detD), _mm_mul_ps(detB, detC)), trace);
+
+    __m128 invDet = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), det);
+    x = _mm_mul_ps(x, invDet);
+    y = _mm_mul_ps(y, invDet);
+    z = _mm_mul_ps(z, invDet);
+    w = _mm_mul_ps(w, invDet);
+
+    Tmat4<float> result;
+    _mm_storeu_ps(&result[0][0], VMATH_SHUFFLE(x, y, 3, 1, 3, 1));
+    _mm_storeu_ps(&result[1][0], VMATH_SHUFFLE(x, y, 2, 0, 2, 0));
+    _mm_storeu_ps(&result[2][0], VMATH_SHUFFLE(z, w, 3, 1, 3, 1));
+    _mm_storeu_ps(&result[3][0], VMATH_SHUFFLE(z, w, 2, 0, 2, 0));
+    return result;
+}
+
+#undef VMATH_SHUFFLE
+#undef VMATH_SWIZZLE
+#endif
+
 template <typename T, const int N>
 static inline vecN<T,N> operator/(const T s, const vecN<T,N>& v)
 {